@@ -8,6 +8,16 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include "headless.h"
 
 // View settings
 float viewD = 5.0f;
@@ -15,6 +25,10 @@ bool usePerspective = false; // false = Ortho, true = Perspective
 int viewPoint = 0; // 0 = (0,0,d), 1 = (0, 0.5d, d)
 bool show3D = false; // Toggle between 2D Initials and 3D Surname
 
+// 3D text settings
+char text3D[64] = "Y"; // Glyphs Y, L and X; other characters leave a gap
+float extrusionDepth = 0.2f;
+
 // Rotation settings
 float rotationX = 0.0f;
 float rotationY = 0.0f;
@@ -31,228 +45,1021 @@ enum PrimitiveMode {
     PRIM_QUAD_STRIP
 };
 PrimitiveMode currentMode = PRIM_TRIANGLES;
-int vertexCount = 0;
-
-// Helper to draw a quad using different primitives
-// Vertices order: BL, BR, TR, TL
-void drawQuad(glm::vec2 v1, glm::vec2 v2, glm::vec2 v3, glm::vec2 v4) {
-    switch (currentMode) {
-        case PRIM_TRIANGLES:
-            glBegin(GL_TRIANGLES);
-            // Triangle 1: BL, BR, TL
-            glVertex2f(v1.x, v1.y);
-            glVertex2f(v2.x, v2.y);
-            glVertex2f(v4.x, v4.y);
-            // Triangle 2: BR, TR, TL
-            glVertex2f(v2.x, v2.y);
-            glVertex2f(v3.x, v3.y);
-            glVertex2f(v4.x, v4.y);
-            glEnd();
-            vertexCount += 6;
-            break;
-        case PRIM_TRIANGLE_STRIP:
-            glBegin(GL_TRIANGLE_STRIP);
-            // Order: BL, BR, TL, TR
-            glVertex2f(v1.x, v1.y);
-            glVertex2f(v2.x, v2.y);
-            glVertex2f(v4.x, v4.y);
-            glVertex2f(v3.x, v3.y);
-            glEnd();
-            vertexCount += 4;
-            break;
-        case PRIM_QUADS:
-            glBegin(GL_QUADS);
-            // Order: BL, BR, TR, TL
-            glVertex2f(v1.x, v1.y);
-            glVertex2f(v2.x, v2.y);
-            glVertex2f(v3.x, v3.y);
-            glVertex2f(v4.x, v4.y);
-            glEnd();
-            vertexCount += 4;
-            break;
-        case PRIM_QUAD_STRIP:
-            glBegin(GL_QUAD_STRIP);
-            // Order: BL, BR, TL, TR (Similar to Triangle Strip but defines quads)
-            glVertex2f(v1.x, v1.y);
-            glVertex2f(v2.x, v2.y);
-            glVertex2f(v4.x, v4.y);
-            glVertex2f(v3.x, v3.y);
-            glEnd();
-            vertexCount += 4;
-            break;
-    }
+int vertexCount = 0; // Vertices submitted this frame (restart markers excluded, instances included)
+
+// ---------------------------------------------------------------------------------------------------------
+// Buffer Object Functions (gl.h only guarantees OpenGL 1.1 on Windows, so load them like lab 3 does)
+// ---------------------------------------------------------------------------------------------------------
+#ifdef _WIN32
+#define APIENTRY __stdcall
+#else
+#define APIENTRY
+#endif
+
+typedef ptrdiff_t GLsizeiptr;
+
+#define GL_ARRAY_BUFFER         0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STATIC_DRAW          0x88E4
+#define GL_PRIMITIVE_RESTART    0x8F9D
+#define GL_MAJOR_VERSION        0x821B
+#define GL_MINOR_VERSION        0x821C
+#define GL_FRAGMENT_SHADER      0x8B30
+#define GL_VERTEX_SHADER        0x8B31
+#define GL_LINK_STATUS          0x8B82
+
+#define GL_QUERY_RESULT                    0x8866
+#define GL_QUERY_RESULT_AVAILABLE          0x8867
+#define GL_TIME_ELAPSED                    0x88BF
+#define GL_PRIMITIVES_GENERATED            0x8C87
+#define GL_VERTICES_SUBMITTED_ARB          0x82EE
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB   0x82F0
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+
+typedef char GLchar;
+typedef uint64_t GLuint64;
+
+typedef void (APIENTRY *PFNGLGENBUFFERSPROC) (GLsizei n, GLuint *buffers);
+typedef void (APIENTRY *PFNGLDELETEBUFFERSPROC) (GLsizei n, const GLuint *buffers);
+typedef void (APIENTRY *PFNGLBINDBUFFERPROC) (GLenum target, GLuint buffer);
+typedef void (APIENTRY *PFNGLBUFFERDATAPROC) (GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+typedef void (APIENTRY *PFNGLPRIMITIVERESTARTINDEXPROC) (GLuint index);
+typedef void (APIENTRY *PFNGLMULTIDRAWELEMENTSPROC) (GLenum mode, const GLsizei *count, GLenum type, const void *const*indices, GLsizei drawcount);
+typedef GLuint (APIENTRY *PFNGLCREATESHADERPROC) (GLenum type);
+typedef void (APIENTRY *PFNGLSHADERSOURCEPROC) (GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length);
+typedef void (APIENTRY *PFNGLCOMPILESHADERPROC) (GLuint shader);
+typedef void (APIENTRY *PFNGLDELETESHADERPROC) (GLuint shader);
+typedef GLuint (APIENTRY *PFNGLCREATEPROGRAMPROC) (void);
+typedef void (APIENTRY *PFNGLATTACHSHADERPROC) (GLuint program, GLuint shader);
+typedef void (APIENTRY *PFNGLLINKPROGRAMPROC) (GLuint program);
+typedef void (APIENTRY *PFNGLGETPROGRAMIVPROC) (GLuint program, GLenum pname, GLint *params);
+typedef void (APIENTRY *PFNGLGETPROGRAMINFOLOGPROC) (GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog);
+typedef void (APIENTRY *PFNGLUSEPROGRAMPROC) (GLuint program);
+typedef void (APIENTRY *PFNGLDELETEPROGRAMPROC) (GLuint program);
+typedef GLint (APIENTRY *PFNGLGETUNIFORMLOCATIONPROC) (GLuint program, const GLchar *name);
+typedef void (APIENTRY *PFNGLUNIFORM4FVPROC) (GLint location, GLsizei count, const GLfloat *value);
+typedef void (APIENTRY *PFNGLDRAWELEMENTSINSTANCEDPROC) (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount);
+typedef void (APIENTRY *PFNGLGENQUERIESPROC) (GLsizei n, GLuint *ids);
+typedef void (APIENTRY *PFNGLDELETEQUERIESPROC) (GLsizei n, const GLuint *ids);
+typedef void (APIENTRY *PFNGLBEGINQUERYPROC) (GLenum target, GLuint id);
+typedef void (APIENTRY *PFNGLENDQUERYPROC) (GLenum target);
+typedef void (APIENTRY *PFNGLGETQUERYOBJECTUIVPROC) (GLuint id, GLenum pname, GLuint *params);
+typedef void (APIENTRY *PFNGLGETQUERYOBJECTUI64VPROC) (GLuint id, GLenum pname, GLuint64 *params);
+
+PFNGLGENBUFFERSPROC glGenBuffers = NULL;
+PFNGLDELETEBUFFERSPROC glDeleteBuffers = NULL;
+PFNGLBINDBUFFERPROC glBindBuffer = NULL;
+PFNGLBUFFERDATAPROC glBufferData = NULL;
+PFNGLPRIMITIVERESTARTINDEXPROC glPrimitiveRestartIndex = NULL; // OpenGL 3.1
+PFNGLMULTIDRAWELEMENTSPROC glMultiDrawElements = NULL;         // OpenGL 1.4
+PFNGLCREATESHADERPROC glCreateShader = NULL;                   // OpenGL 2.0 from here on
+PFNGLSHADERSOURCEPROC glShaderSource = NULL;
+PFNGLCOMPILESHADERPROC glCompileShader = NULL;
+PFNGLDELETESHADERPROC glDeleteShader = NULL;
+PFNGLCREATEPROGRAMPROC glCreateProgram = NULL;
+PFNGLATTACHSHADERPROC glAttachShader = NULL;
+PFNGLLINKPROGRAMPROC glLinkProgram = NULL;
+PFNGLGETPROGRAMIVPROC glGetProgramiv = NULL;
+PFNGLGETPROGRAMINFOLOGPROC glGetProgramInfoLog = NULL;
+PFNGLUSEPROGRAMPROC glUseProgram = NULL;
+PFNGLDELETEPROGRAMPROC glDeleteProgram = NULL;
+PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation = NULL;
+PFNGLUNIFORM4FVPROC glUniform4fv = NULL;
+PFNGLDRAWELEMENTSINSTANCEDPROC glDrawElementsInstanced = NULL; // OpenGL 3.1, optional
+PFNGLGENQUERIESPROC glGenQueries = NULL;                       // OpenGL 1.5
+PFNGLDELETEQUERIESPROC glDeleteQueries = NULL;
+PFNGLBEGINQUERYPROC glBeginQuery = NULL;
+PFNGLENDQUERYPROC glEndQuery = NULL;
+PFNGLGETQUERYOBJECTUIVPROC glGetQueryObjectuiv = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v = NULL;     // OpenGL 3.3 / ARB_timer_query, optional
+
+bool loadOpenGLFunctions(HeadlessProc (*getProcAddress)(const char*)) {
+    glGenBuffers = (PFNGLGENBUFFERSPROC)getProcAddress("glGenBuffers");
+    glDeleteBuffers = (PFNGLDELETEBUFFERSPROC)getProcAddress("glDeleteBuffers");
+    glBindBuffer = (PFNGLBINDBUFFERPROC)getProcAddress("glBindBuffer");
+    glBufferData = (PFNGLBUFFERDATAPROC)getProcAddress("glBufferData");
+    glPrimitiveRestartIndex = (PFNGLPRIMITIVERESTARTINDEXPROC)getProcAddress("glPrimitiveRestartIndex");
+    glMultiDrawElements = (PFNGLMULTIDRAWELEMENTSPROC)getProcAddress("glMultiDrawElements");
+    glCreateShader = (PFNGLCREATESHADERPROC)getProcAddress("glCreateShader");
+    glShaderSource = (PFNGLSHADERSOURCEPROC)getProcAddress("glShaderSource");
+    glCompileShader = (PFNGLCOMPILESHADERPROC)getProcAddress("glCompileShader");
+    glDeleteShader = (PFNGLDELETESHADERPROC)getProcAddress("glDeleteShader");
+    glCreateProgram = (PFNGLCREATEPROGRAMPROC)getProcAddress("glCreateProgram");
+    glAttachShader = (PFNGLATTACHSHADERPROC)getProcAddress("glAttachShader");
+    glLinkProgram = (PFNGLLINKPROGRAMPROC)getProcAddress("glLinkProgram");
+    glGetProgramiv = (PFNGLGETPROGRAMIVPROC)getProcAddress("glGetProgramiv");
+    glGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)getProcAddress("glGetProgramInfoLog");
+    glUseProgram = (PFNGLUSEPROGRAMPROC)getProcAddress("glUseProgram");
+    glDeleteProgram = (PFNGLDELETEPROGRAMPROC)getProcAddress("glDeleteProgram");
+    glGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)getProcAddress("glGetUniformLocation");
+    glUniform4fv = (PFNGLUNIFORM4FVPROC)getProcAddress("glUniform4fv");
+    glDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDPROC)getProcAddress("glDrawElementsInstanced");
+    glGenQueries = (PFNGLGENQUERIESPROC)getProcAddress("glGenQueries");
+    glDeleteQueries = (PFNGLDELETEQUERIESPROC)getProcAddress("glDeleteQueries");
+    glBeginQuery = (PFNGLBEGINQUERYPROC)getProcAddress("glBeginQuery");
+    glEndQuery = (PFNGLENDQUERYPROC)getProcAddress("glEndQuery");
+    glGetQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVPROC)getProcAddress("glGetQueryObjectuiv");
+    glGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)getProcAddress("glGetQueryObjectui64v");
+    return glGenBuffers && glDeleteBuffers && glBindBuffer && glBufferData && glMultiDrawElements;
 }
 
-// Helper to draw a rectangle (axis aligned)
-void drawRect(float x, float y, float w, float h) {
-    glm::vec2 v1(x, y);         // BL
-    glm::vec2 v2(x + w, y);     // BR
-    glm::vec2 v3(x + w, y + h); // TR
-    glm::vec2 v4(x, y + h);     // TL
-    drawQuad(v1, v2, v3, v4);
+// ---------------------------------------------------------------------------------------------------------
+// 2D Letters
+// ---------------------------------------------------------------------------------------------------------
+// Each letter is a list of quads with vertices in BL, BR, TR, TL order, centered roughly at (0,0)
+// with height ~1.0. They are uploaded once into a shared vertex buffer (4 vertices per quad) and an
+// index buffer that holds, per letter and per primitive mode, the order that mode needs:
+//   GL_TRIANGLES       BL, BR, TL, BR, TR, TL
+//   GL_TRIANGLE_STRIP  BL, BR, TL, TR, restart
+//   GL_QUADS           BL, BR, TR, TL
+//   GL_QUAD_STRIP      BL, BR, TL, TR, restart
+// so every letter is one glDrawElements call in any mode. Without primitive restart (before OpenGL
+// 3.1) the strips are drawn with one glMultiDrawElements call instead.
+typedef std::vector<std::array<glm::vec2, 4>> QuadList;
+
+// Axis aligned rectangle
+void addRect(QuadList& quads, float x, float y, float w, float h) {
+    quads.push_back({ glm::vec2(x, y), glm::vec2(x + w, y), glm::vec2(x + w, y + h), glm::vec2(x, y + h) });
 }
 
-// Draw Letter Y
-// Centered roughly at (0,0) with height ~1.0
-void drawLetterY() {
-    glColor3f(1.0f, 0.0f, 0.0f); // Red
+QuadList letterYQuads() {
+    QuadList quads;
 
     // Vertical stem (bottom half)
     // x: -0.05 to 0.05, y: -0.5 to 0.0
-    drawRect(-0.05f, -0.5f, 0.1f, 0.5f);
+    addRect(quads, -0.05f, -0.5f, 0.1f, 0.5f);
 
     // Left arm
-    // Left arm quad
-    // BL: (-0.05, 0.0), BR: (0.05, 0.0)
-    // TL: (-0.35, 0.5), TR: (-0.25, 0.5)
-    // Wait, drawQuad expects BL, BR, TR, TL
-    // Let's map them:
-    // v1 (BL) = (-0.05, 0.0)
-    // v2 (BR) = (0.05, 0.0)
-    // v3 (TR) = (-0.25, 0.5)
-    // v4 (TL) = (-0.35, 0.5) -- Wait, this is twisted if I use standard rect logic.
-    // Let's visualize:
     // (-0.35, 0.5)   (-0.25, 0.5)
     //      TL           TR
     //
     //      BL           BR
     // (-0.05, 0.0)   (0.05, 0.0)
-    // This is a valid quad.
-    drawQuad(glm::vec2(-0.05f, 0.0f), glm::vec2(0.05f, 0.0f), glm::vec2(-0.25f, 0.5f), glm::vec2(-0.35f, 0.5f));
+    quads.push_back({ glm::vec2(-0.05f, 0.0f), glm::vec2(0.05f, 0.0f), glm::vec2(-0.25f, 0.5f), glm::vec2(-0.35f, 0.5f) });
 
-    // Right arm quad
+    // Right arm
     // BL: (-0.05, 0.0), BR: (0.05, 0.0)
     // TL: (0.25, 0.5), TR: (0.35, 0.5)
-    // v1 (BL) = (-0.05, 0.0)
-    // v2 (BR) = (0.05, 0.0)
-    // v3 (TR) = (0.35, 0.5)
-    // v4 (TL) = (0.25, 0.5)
-    drawQuad(glm::vec2(-0.05f, 0.0f), glm::vec2(0.05f, 0.0f), glm::vec2(0.35f, 0.5f), glm::vec2(0.25f, 0.5f));
+    quads.push_back({ glm::vec2(-0.05f, 0.0f), glm::vec2(0.05f, 0.0f), glm::vec2(0.35f, 0.5f), glm::vec2(0.25f, 0.5f) });
+    return quads;
 }
 
-// Draw Letter L
-void drawLetterL() {
-    glColor3f(0.0f, 1.0f, 0.0f); // Green
+QuadList letterLQuads() {
+    QuadList quads;
 
     // Vertical stem
     // x: -0.25 to -0.15, y: -0.5 to 0.5
-    drawRect(-0.25f, -0.5f, 0.1f, 1.0f);
+    addRect(quads, -0.25f, -0.5f, 0.1f, 1.0f);
 
     // Bottom horizontal
     // x: -0.15 to 0.25, y: -0.5 to -0.4
-    drawRect(-0.15f, -0.5f, 0.4f, 0.1f);
+    addRect(quads, -0.15f, -0.5f, 0.4f, 0.1f);
+    return quads;
 }
 
-// Draw Letter X
-void drawLetterX() {
-    glColor3f(0.0f, 0.0f, 1.0f); // Blue
+QuadList letterXQuads() {
+    QuadList quads;
 
     // Stroke 1: \ (Top-Left to Bottom-Right)
     // TL: (-0.35, 0.5), TR: (-0.25, 0.5)
     // BL: (0.25, -0.5), BR: (0.35, -0.5)
-    // v1(BL), v2(BR), v3(TR), v4(TL)
-    drawQuad(glm::vec2(0.25f, -0.5f), glm::vec2(0.35f, -0.5f), glm::vec2(-0.25f, 0.5f), glm::vec2(-0.35f, 0.5f));
+    quads.push_back({ glm::vec2(0.25f, -0.5f), glm::vec2(0.35f, -0.5f), glm::vec2(-0.25f, 0.5f), glm::vec2(-0.35f, 0.5f) });
 
     // Stroke 2: / (Bottom-Left to Top-Right)
     // BL: (-0.35, -0.5), BR: (-0.25, -0.5)
     // TL: (0.25, 0.5), TR: (0.35, 0.5)
-    // v1(BL), v2(BR), v3(TR), v4(TL)
-    drawQuad(glm::vec2(-0.35f, -0.5f), glm::vec2(-0.25f, -0.5f), glm::vec2(0.35f, 0.5f), glm::vec2(0.25f, 0.5f));
+    quads.push_back({ glm::vec2(-0.35f, -0.5f), glm::vec2(-0.25f, -0.5f), glm::vec2(0.35f, 0.5f), glm::vec2(0.25f, 0.5f) });
+    return quads;
 }
 
-// Helper to draw an extruded quad (prism)
-// v1-v4 are 2D vertices (z=0)
-// thickness is the extrusion depth along Z
-void drawExtrudedQuad(glm::vec2 v1, glm::vec2 v2, glm::vec2 v3, glm::vec2 v4, float thickness) {
-    float zFront = thickness / 2.0f;
-    float zBack = -thickness / 2.0f;
-
-    // Front face
-    glBegin(GL_QUADS);
-    glNormal3f(0.0f, 0.0f, 1.0f);
-    glVertex3f(v1.x, v1.y, zFront);
-    glVertex3f(v2.x, v2.y, zFront);
-    glVertex3f(v3.x, v3.y, zFront);
-    glVertex3f(v4.x, v4.y, zFront);
-    glEnd();
-
-    // Back face
-    glBegin(GL_QUADS);
-    glNormal3f(0.0f, 0.0f, -1.0f);
-    glVertex3f(v1.x, v1.y, zBack);
-    glVertex3f(v4.x, v4.y, zBack);
-    glVertex3f(v3.x, v3.y, zBack);
-    glVertex3f(v2.x, v2.y, zBack);
-    glEnd();
-
-    // Side faces
-    glBegin(GL_QUADS);
-    
-    // Bottom (v1-v2)
-    // Normal approx (0, -1, 0) - strictly depends on orientation but good enough for simple shapes
-    glVertex3f(v1.x, v1.y, zBack);
-    glVertex3f(v2.x, v2.y, zBack);
-    glVertex3f(v2.x, v2.y, zFront);
-    glVertex3f(v1.x, v1.y, zFront);
-
-    // Right (v2-v3)
-    glVertex3f(v2.x, v2.y, zBack);
-    glVertex3f(v3.x, v3.y, zBack);
-    glVertex3f(v3.x, v3.y, zFront);
-    glVertex3f(v2.x, v2.y, zFront);
-
-    // Top (v3-v4)
-    glVertex3f(v3.x, v3.y, zBack);
-    glVertex3f(v4.x, v4.y, zBack);
-    glVertex3f(v4.x, v4.y, zFront);
-    glVertex3f(v3.x, v3.y, zFront);
-
-    // Left (v4-v1)
-    glVertex3f(v4.x, v4.y, zBack);
-    glVertex3f(v1.x, v1.y, zBack);
-    glVertex3f(v1.x, v1.y, zFront);
-    glVertex3f(v4.x, v4.y, zFront);
-    
-    glEnd();
+enum Letter { LETTER_Y, LETTER_L, LETTER_X, LETTER_COUNT };
+const glm::vec3 letterColors[LETTER_COUNT] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) }; // Red, green, blue
+const int PRIM_MODE_COUNT = 4;
+const GLenum primitiveModeGL[PRIM_MODE_COUNT] = { GL_TRIANGLES, GL_TRIANGLE_STRIP, GL_QUADS, GL_QUAD_STRIP };
+const GLuint PRIMITIVE_RESTART_INDEX = 0xFFFFFFFFu;
+
+int drawCalls = 0;
+
+struct LetterBatch {
+    struct Range {
+        GLsizei count = 0;    // Indices, restart markers included
+        size_t offset = 0;    // Bytes into the index buffer
+        GLsizei vertices = 0; // Indices minus restart markers: what the GPU is fed
+        std::vector<GLsizei> stripCounts;      // Strip modes without primitive restart
+        std::vector<const void*> stripOffsets;
+    };
+
+    GLuint buffers[2] = {}; // Vertices, indices
+    Range ranges[LETTER_COUNT][PRIM_MODE_COUNT];
+    int uniqueVertices = 0;
+    bool primitiveRestart = false;
+
+    void create() {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        primitiveRestart = glPrimitiveRestartIndex && (major > 3 || (major == 3 && minor >= 1));
+
+        const QuadList letters[LETTER_COUNT] = { letterYQuads(), letterLQuads(), letterXQuads() };
+        // Corner order per mode, as indices into the quad's BL, BR, TR, TL
+        const std::vector<int> corners[PRIM_MODE_COUNT] = { { 0, 1, 3, 1, 2, 3 }, { 0, 1, 3, 2 }, { 0, 1, 2, 3 }, { 0, 1, 3, 2 } };
+        std::vector<glm::vec2> vertices;
+        std::vector<GLuint> indices;
+        for (int letter = 0; letter < LETTER_COUNT; letter++) {
+            GLuint base = (GLuint)vertices.size();
+            for (const auto& quad : letters[letter]) vertices.insert(vertices.end(), quad.begin(), quad.end());
+            for (int mode = 0; mode < PRIM_MODE_COUNT; mode++) {
+                bool strip = mode == PRIM_TRIANGLE_STRIP || mode == PRIM_QUAD_STRIP;
+                Range& range = ranges[letter][mode];
+                range.offset = indices.size() * sizeof(GLuint);
+                for (size_t quad = 0; quad < letters[letter].size(); quad++) {
+                    if (strip) {
+                        range.stripCounts.push_back((GLsizei)corners[mode].size());
+                        range.stripOffsets.push_back((const void*)(indices.size() * sizeof(GLuint)));
+                    }
+                    for (int corner : corners[mode]) indices.push_back(base + (GLuint)quad * 4 + corner);
+                    range.vertices += (GLsizei)corners[mode].size();
+                    if (strip) indices.push_back(PRIMITIVE_RESTART_INDEX);
+                }
+                if (strip) indices.pop_back(); // Nothing to separate after the last strip
+                range.count = (GLsizei)(indices.size() - range.offset / sizeof(GLuint));
+            }
+        }
+        uniqueVertices = (int)vertices.size();
+
+        glGenBuffers(2, buffers);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    // Bind the buffers for a run of draw() calls
+    void begin() {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(2, GL_FLOAT, sizeof(glm::vec2), (const void*)0);
+        if (primitiveRestart) {
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(PRIMITIVE_RESTART_INDEX);
+        }
+    }
+
+    void draw(Letter letter, PrimitiveMode mode) {
+        const Range& range = ranges[letter][mode];
+        bool strip = mode == PRIM_TRIANGLE_STRIP || mode == PRIM_QUAD_STRIP;
+        if (strip && !primitiveRestart) {
+            glMultiDrawElements(primitiveModeGL[mode], range.stripCounts.data(), GL_UNSIGNED_INT, range.stripOffsets.data(), (GLsizei)range.stripCounts.size());
+        } else {
+            glDrawElements(primitiveModeGL[mode], range.count, GL_UNSIGNED_INT, (const void*)range.offset);
+        }
+        vertexCount += range.vertices;
+        drawCalls++;
+    }
+
+    void end() {
+        if (primitiveRestart) glDisable(GL_PRIMITIVE_RESTART);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    void destroy() {
+        glDeleteBuffers(2, buffers);
+    }
+};
+
+LetterBatch letterBatch;
+
+// ---------------------------------------------------------------------------------------------------------
+// 3D Glyphs: Tessellation, Extrusion and Cache
+// ---------------------------------------------------------------------------------------------------------
+// A glyph is a set of closed polygon contours: outer contours counter-clockwise, holes clockwise
+// (a hole belongs to the outer contour that contains it). Each outer contour is triangulated by ear
+// clipping, with its holes first bridged into it, and the result is extruded along Z: front and back
+// caps plus one flat-shaded quad per contour edge whose normal points out of the solid. The letters'
+// overlapping quads are unioned into a single welded outline first, so joints have no internal faces
+// to rasterize or Z-fight, and straight runs become a single side quad. Meshes are cached on the GPU
+// by (glyph, extrusion depth), so a 3D string costs one instanced draw per distinct glyph, offsets
+// coming from a uniform array, instead of re-tessellating every frame.
+typedef std::vector<glm::vec2> Contour;
+
+struct GlyphOutline {
+    std::vector<Contour> contours;
+};
+
+float signedArea(const Contour& contour) {
+    float area = 0.0f;
+    for (size_t i = 0, j = contour.size() - 1; i < contour.size(); j = i++) {
+        area += contour[j].x * contour[i].y - contour[i].x * contour[j].y;
+    }
+    return area * 0.5f;
 }
 
-// Draw Letter Y in 3D
-void drawLetterY3D() {
-    glColor3f(1.0f, 0.5f, 0.0f); // Orange for 3D
-    float thickness = 0.2f;
+float cross2(glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
 
-    // Vertical stem
-    drawExtrudedQuad(glm::vec2(-0.05f, -0.5f), glm::vec2(0.05f, -0.5f), glm::vec2(0.05f, 0.0f), glm::vec2(-0.05f, 0.0f), thickness);
+bool pointInTriangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    return cross2(a, b, p) >= 0.0f && cross2(b, c, p) >= 0.0f && cross2(c, a, p) >= 0.0f;
+}
 
-    // Left arm
-    drawExtrudedQuad(glm::vec2(-0.05f, 0.0f), glm::vec2(0.05f, 0.0f), glm::vec2(-0.25f, 0.5f), glm::vec2(-0.35f, 0.5f), thickness);
+bool pointInContour(glm::vec2 p, const Contour& contour) {
+    bool inside = false;
+    for (size_t i = 0, j = contour.size() - 1; i < contour.size(); j = i++) {
+        const glm::vec2& a = contour[i];
+        const glm::vec2& b = contour[j];
+        if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x) inside = !inside;
+    }
+    return inside;
+}
 
-    // Right arm
-    drawExtrudedQuad(glm::vec2(-0.05f, 0.0f), glm::vec2(0.05f, 0.0f), glm::vec2(0.35f, 0.5f), glm::vec2(0.25f, 0.5f), thickness);
+// Splice a clockwise hole into a counter-clockwise polygon (both as vertex indices into `points`)
+// through a bridge from the hole's rightmost vertex to a visible polygon vertex (Eberly's method)
+void bridgeHole(std::vector<int>& polygon, const std::vector<int>& hole, const std::vector<glm::vec2>& points) {
+    size_t start = 0;
+    for (size_t i = 1; i < hole.size(); i++) {
+        if (points[hole[i]].x > points[hole[start]].x) start = i;
+    }
+    glm::vec2 m = points[hole[start]];
+
+    // Nearest polygon edge hit by a ray from m towards +x; its endpoint with the larger x is the candidate
+    float nearestX = std::numeric_limits<float>::max();
+    int candidate = -1;
+    for (size_t i = 0; i < polygon.size(); i++) {
+        glm::vec2 a = points[polygon[i]];
+        glm::vec2 b = points[polygon[(i + 1) % polygon.size()]];
+        if ((a.y > m.y) == (b.y > m.y)) continue;
+        float x = a.x + (m.y - a.y) * (b.x - a.x) / (b.y - a.y);
+        if (x < m.x || x >= nearestX) continue;
+        nearestX = x;
+        candidate = (int)(a.x > b.x ? i : (i + 1) % polygon.size());
+    }
+    if (candidate < 0) return; // Hole outside its polygon: ignore it
+
+    // A reflex vertex inside triangle (m, hit, candidate) would block the bridge; take the one at the
+    // smallest angle to the ray instead
+    glm::vec2 hit(nearestX, m.y);
+    glm::vec2 p = points[polygon[candidate]];
+    float bestAngle = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < polygon.size(); i++) {
+        glm::vec2 v = points[polygon[i]];
+        glm::vec2 prev = points[polygon[(i + polygon.size() - 1) % polygon.size()]];
+        glm::vec2 next = points[polygon[(i + 1) % polygon.size()]];
+        bool reflex = cross2(prev, v, next) < 0.0f;
+        bool blocks = p.y > m.y ? pointInTriangle(v, m, hit, p) : pointInTriangle(v, m, p, hit);
+        if ((int)i == candidate || !reflex || !blocks) continue;
+        float angle = std::atan2(std::fabs(v.y - m.y), v.x - m.x);
+        if (angle < bestAngle) {
+            bestAngle = angle;
+            candidate = (int)i;
+        }
+    }
+
+    // polygon[..candidate], hole from start all the way round back to start, candidate, polygon[candidate + 1..]
+    std::vector<int> merged(polygon.begin(), polygon.begin() + candidate + 1);
+    for (size_t i = 0; i <= hole.size(); i++) merged.push_back(hole[(start + i) % hole.size()]);
+    merged.insert(merged.end(), polygon.begin() + candidate, polygon.end());
+    polygon.swap(merged);
+}
+
+// Ear clipping of a simple counter-clockwise polygon; appends counter-clockwise triangles
+void earClip(std::vector<int> polygon, const std::vector<glm::vec2>& points, std::vector<GLuint>& triangles) {
+    size_t guard = 0;
+    while (polygon.size() > 3 && guard++ < polygon.size() * polygon.size()) {
+        bool clipped = false;
+        for (size_t i = 0; i < polygon.size() && !clipped; i++) {
+            int prev = polygon[(i + polygon.size() - 1) % polygon.size()];
+            int current = polygon[i];
+            int next = polygon[(i + 1) % polygon.size()];
+            const glm::vec2& a = points[prev];
+            const glm::vec2& b = points[current];
+            const glm::vec2& c = points[next];
+            if (cross2(a, b, c) <= 0.0f) continue; // Reflex or degenerate: not an ear
+
+            bool empty = true;
+            for (int other : polygon) {
+                // Bridged holes repeat vertices, so compare positions rather than indices
+                const glm::vec2& p = points[other];
+                if (p == a || p == b || p == c) continue;
+                if (pointInTriangle(p, a, b, c)) { empty = false; break; }
+            }
+            if (!empty) continue;
+
+            triangles.insert(triangles.end(), { (GLuint)prev, (GLuint)current, (GLuint)next });
+            polygon.erase(polygon.begin() + i);
+            clipped = true;
+        }
+        if (!clipped) break; // Self-intersecting input: keep what was clipped so far
+    }
+    if (polygon.size() == 3 && cross2(points[polygon[0]], points[polygon[1]], points[polygon[2]]) > 0.0f) {
+        triangles.insert(triangles.end(), { (GLuint)polygon[0], (GLuint)polygon[1], (GLuint)polygon[2] });
+    }
+}
+
+// Cap triangles over all contour points (indices follow the contours' concatenated order)
+std::vector<GLuint> triangulateOutline(const GlyphOutline& outline) {
+    std::vector<glm::vec2> points;
+    std::vector<std::vector<int>> outers, holes;
+    for (const Contour& contour : outline.contours) {
+        std::vector<int> indices;
+        for (const glm::vec2& point : contour) {
+            indices.push_back((int)points.size());
+            points.push_back(point);
+        }
+        (signedArea(contour) >= 0.0f ? outers : holes).push_back(indices);
+    }
+
+    // Holes go in right to left, so later bridges never cross earlier ones
+    std::sort(holes.begin(), holes.end(), [&](const std::vector<int>& a, const std::vector<int>& b) {
+        auto maxX = [&](const std::vector<int>& hole) {
+            float x = -std::numeric_limits<float>::max();
+            for (int i : hole) x = std::max(x, points[i].x);
+            return x;
+        };
+        return maxX(a) > maxX(b);
+    });
+    for (const std::vector<int>& hole : holes) {
+        for (std::vector<int>& outer : outers) {
+            Contour polygon;
+            for (int i : outer) polygon.push_back(points[i]);
+            if (!pointInContour(points[hole[0]], polygon)) continue;
+            bridgeHole(outer, hole, points);
+            break;
+        }
+    }
+
+    std::vector<GLuint> triangles;
+    for (const std::vector<int>& outer : outers) earClip(outer, points, triangles);
+    return triangles;
+}
+
+// Interleaved position + normal, ready for glVertexPointer / glNormalPointer
+struct GlyphVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+void extrudeOutline(const GlyphOutline& outline, float depth, std::vector<GlyphVertex>& vertices, std::vector<GLuint>& indices) {
+    float zFront = depth / 2.0f;
+    float zBack = -depth / 2.0f;
+    std::vector<GLuint> cap = triangulateOutline(outline);
+
+    // Front face, then back face (same points, reversed winding)
+    GLuint front = (GLuint)vertices.size();
+    for (const Contour& contour : outline.contours)
+        for (const glm::vec2& p : contour) vertices.push_back({ glm::vec3(p, zFront), glm::vec3(0.0f, 0.0f, 1.0f) });
+    GLuint back = (GLuint)vertices.size();
+    for (const Contour& contour : outline.contours)
+        for (const glm::vec2& p : contour) vertices.push_back({ glm::vec3(p, zBack), glm::vec3(0.0f, 0.0f, -1.0f) });
+    for (size_t i = 0; i < cap.size(); i += 3) {
+        indices.insert(indices.end(), { front + cap[i], front + cap[i + 1], front + cap[i + 2] });
+        indices.insert(indices.end(), { back + cap[i], back + cap[i + 2], back + cap[i + 1] });
+    }
+
+    // Side faces: own vertices per edge so the normal stays flat. With outers counter-clockwise and
+    // holes clockwise, (dy, -dx) always points away from the solid
+    for (const Contour& contour : outline.contours) {
+        for (size_t i = 0; i < contour.size(); i++) {
+            glm::vec2 a = contour[i];
+            glm::vec2 b = contour[(i + 1) % contour.size()];
+            glm::vec2 edge = b - a;
+            if (glm::dot(edge, edge) == 0.0f) continue;
+            glm::vec3 normal = glm::normalize(glm::vec3(edge.y, -edge.x, 0.0f));
+            GLuint base = (GLuint)vertices.size();
+            vertices.push_back({ glm::vec3(a, zBack), normal });
+            vertices.push_back({ glm::vec3(b, zBack), normal });
+            vertices.push_back({ glm::vec3(b, zFront), normal });
+            vertices.push_back({ glm::vec3(a, zFront), normal });
+            indices.insert(indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+        }
+    }
 }
 
+bool pointInUnion(glm::vec2 p, const std::vector<Contour>& contours) {
+    for (const Contour& contour : contours)
+        if (pointInContour(p, contour)) return true;
+    return false;
+}
+
+// Boundary of the union of overlapping counter-clockwise contours. Every edge is split wherever another
+// edge crosses or touches it, and a piece survives only if the union lies on its left and not on its
+// right: pieces inside another contour and seams where two contours meet edge to edge are dropped,
+// pieces that several contours share along the boundary are kept once. The survivors are welded by
+// position, chained into loops (outers counter-clockwise, enclosed gaps clockwise, i.e. holes) and
+// collinear runs are merged, so extrusion sees no internal caps or side faces.
+std::vector<Contour> unionContours(const std::vector<Contour>& contours) {
+    const float EPSILON = 1e-5f;
+    const float PROBE = 1e-4f; // Distance of the inside/outside samples from a piece
+    auto near = [&](glm::vec2 a, glm::vec2 b) { return glm::dot(a - b, a - b) < EPSILON * EPSILON; };
+
+    typedef std::pair<glm::vec2, glm::vec2> Edge;
+    std::vector<Edge> edges;
+    for (const Contour& contour : contours)
+        for (size_t i = 0; i < contour.size(); i++) edges.push_back({ contour[i], contour[(i + 1) % contour.size()] });
+
+    std::vector<Edge> boundary;
+    for (const Edge& e : edges) {
+        glm::vec2 r = e.second - e.first;
+        float length = glm::length(r);
+        if (length < EPSILON) continue;
+        std::vector<float> cuts = { 0.0f, 1.0f };
+        for (const Edge& f : edges) {
+            glm::vec2 s = f.second - f.first;
+            glm::vec2 d = f.first - e.first;
+            float denom = r.x * s.y - r.y * s.x;
+            if (std::fabs(denom) > 1e-12f) {
+                float t = (d.x * s.y - d.y * s.x) / denom;
+                float u = (d.x * r.y - d.y * r.x) / denom;
+                if (t > 0.0f && t < 1.0f && u >= 0.0f && u <= 1.0f) cuts.push_back(t);
+            }
+            // Endpoints of other edges lying on this one: collinear overlaps and T-junctions
+            for (glm::vec2 p : { f.first, f.second }) {
+                float t = glm::dot(p - e.first, r) / (length * length);
+                if (t > 0.0f && t < 1.0f && near(p, e.first + t * r)) cuts.push_back(t);
+            }
+        }
+        std::sort(cuts.begin(), cuts.end());
+        float start = 0.0f;
+        for (float cut : cuts) {
+            if ((cut - start) * length < EPSILON) continue;
+            glm::vec2 a = e.first + start * r, b = e.first + cut * r;
+            start = cut;
+            glm::vec2 mid = (a + b) * 0.5f;
+            glm::vec2 left = glm::normalize(glm::vec2(a.y - b.y, b.x - a.x)) * PROBE;
+            if (!pointInUnion(mid + left, contours) || pointInUnion(mid - left, contours)) continue;
+            bool duplicate = false;
+            for (const Edge& kept : boundary) duplicate = duplicate || (near(kept.first, a) && near(kept.second, b));
+            if (!duplicate) boundary.push_back({ a, b });
+        }
+    }
+
+    // Weld: one vertex per distinct position, edges as index pairs
+    std::vector<glm::vec2> points;
+    auto weld = [&](glm::vec2 p) {
+        for (size_t i = 0; i < points.size(); i++)
+            if (near(points[i], p)) return (int)i;
+        points.push_back(p);
+        return (int)points.size() - 1;
+    };
+    std::vector<std::pair<int, int>> welded;
+    for (const Edge& e : boundary) {
+        int a = weld(e.first), b = weld(e.second);
+        if (a != b) welded.push_back({ a, b });
+    }
+
+    // Chain into loops. Where loops touch at a vertex, take the sharpest left turn so each loop stays simple
+    std::vector<bool> used(welded.size(), false);
+    std::vector<Contour> loops;
+    for (size_t first = 0; first < welded.size(); first++) {
+        if (used[first]) continue;
+        std::vector<int> loop;
+        size_t current = first;
+        while (!used[current]) {
+            used[current] = true;
+            loop.push_back(welded[current].first);
+            glm::vec2 in = points[welded[current].second] - points[welded[current].first];
+            float bestTurn = -std::numeric_limits<float>::max();
+            size_t next = current;
+            for (size_t i = 0; i < welded.size(); i++) {
+                if (used[i] && i != first) continue;
+                if (welded[i].first != welded[current].second) continue;
+                glm::vec2 out = points[welded[i].second] - points[welded[i].first];
+                float turn = std::atan2(in.x * out.y - in.y * out.x, glm::dot(in, out));
+                if (turn > bestTurn) {
+                    bestTurn = turn;
+                    next = i;
+                }
+            }
+            current = next;
+        }
+
+        // Drop vertices in the middle of a straight run
+        for (bool merged = true; merged && loop.size() > 3;) {
+            merged = false;
+            for (size_t i = 0; i < loop.size() && loop.size() > 3; i++) {
+                glm::vec2 a = points[loop[(i + loop.size() - 1) % loop.size()]];
+                glm::vec2 b = points[loop[i]];
+                glm::vec2 c = points[loop[(i + 1) % loop.size()]];
+                if (std::fabs(cross2(a, b, c)) < EPSILON * glm::length(c - a) && glm::dot(b - a, c - b) > 0.0f) {
+                    loop.erase(loop.begin() + i);
+                    merged = true;
+                }
+            }
+        }
+        if (loop.size() < 3) continue;
+        Contour contour;
+        for (int i : loop) contour.push_back(points[i]);
+        loops.push_back(contour);
+    }
+    return loops;
+}
+
+// Glyph outlines: the union of the 2D letters' quads
+bool glyphOutline(char glyph, GlyphOutline& outline) {
+    QuadList quads;
+    switch (glyph) {
+        case 'Y': quads = letterYQuads(); break;
+        case 'L': quads = letterLQuads(); break;
+        case 'X': quads = letterXQuads(); break;
+        default: return false;
+    }
+    std::vector<Contour> pieces;
+    for (const auto& quad : quads) pieces.push_back(Contour(quad.begin(), quad.end()));
+    outline.contours = unionContours(pieces);
+    return true;
+}
+
+struct GlyphMesh {
+    GLuint buffers[2] = {}; // Vertices, indices
+    GLsizei indexCount = 0;
+    int vertexCount = 0;
+};
+
+const int MAX_GLYPH_INSTANCES = 64; // Offsets per instanced draw
+
+const char* glyphVertexShaderSource = R"(
+#version 130
+#extension GL_ARB_draw_instanced : require
+uniform vec4 offsets[64];
+out vec3 normal;
+void main() {
+    gl_Position = gl_ModelViewProjectionMatrix * (gl_Vertex + vec4(offsets[gl_InstanceIDARB].xyz, 0.0));
+    normal = gl_NormalMatrix * gl_Normal;
+    gl_FrontColor = gl_Color;
+}
+)";
+
+// Headlight: diffuse from the viewer's direction, so the side normals show
+const char* glyphFragmentShaderSource = R"(
+#version 130
+in vec3 normal;
+void main() {
+    float diffuse = abs(normalize(normal).z);
+    gl_FragColor = vec4(gl_Color.rgb * (0.35 + 0.65 * diffuse), gl_Color.a);
+}
+)";
+
+struct GlyphCache {
+    std::map<char, GlyphMesh> meshes; // Unit depth; drawString scales z to the extrusion depth
+    GLuint program = 0;
+    GLint offsetsLocation = -1;
+    int builds = 0;
+    size_t bytes = 0;
+
+    // Compile the instancing shader; without it glyphs are drawn one by one with fixed function
+    void create() {
+        if (!glCreateShader || !glDrawElementsInstanced) return;
+        GLuint shaders[2] = { glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER) };
+        const char* sources[2] = { glyphVertexShaderSource, glyphFragmentShaderSource };
+        program = glCreateProgram();
+        for (int i = 0; i < 2; i++) {
+            glShaderSource(shaders[i], 1, &sources[i], NULL);
+            glCompileShader(shaders[i]);
+            glAttachShader(program, shaders[i]);
+        }
+        glLinkProgram(program);
+        for (GLuint shader : shaders) glDeleteShader(shader);
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char log[1024];
+            glGetProgramInfoLog(program, sizeof(log), NULL, log);
+            std::cout << "Glyph shader failed, drawing glyphs without instancing:\n" << log << std::endl;
+            glDeleteProgram(program);
+            program = 0;
+            return;
+        }
+        offsetsLocation = glGetUniformLocation(program, "offsets");
+    }
+
+    // The unit-depth mesh for a glyph, tessellated and uploaded on first use; NULL if unknown
+    const GlyphMesh* get(char glyph) {
+        auto it = meshes.find(glyph);
+        if (it != meshes.end()) return &it->second;
+
+        GlyphOutline outline;
+        if (!glyphOutline(glyph, outline)) return NULL;
+        std::vector<GlyphVertex> vertices;
+        std::vector<GLuint> indices;
+        extrudeOutline(outline, 1.0f, vertices, indices);
+
+        GlyphMesh& mesh = meshes[glyph];
+        glGenBuffers(2, mesh.buffers);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GlyphVertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        mesh.indexCount = (GLsizei)indices.size();
+        mesh.vertexCount = (int)vertices.size();
+        bytes += vertices.size() * sizeof(GlyphVertex) + indices.size() * sizeof(GLuint);
+        builds++;
+        return &mesh;
+    }
+
+    // Lay the string out left to right, centered on the origin, and draw each distinct glyph once.
+    // The caps sit at z = +-1/2 and the side normals have no z, so depth is a pure z scale
+    // (gl_NormalMatrix keeps the cap normals right; the shader renormalizes)
+    void drawString(const std::string& text, float depth, float advance) {
+        std::map<char, std::vector<glm::vec4>> offsets;
+        for (size_t i = 0; i < text.size(); i++) {
+            float x = ((float)i - (text.size() - 1) / 2.0f) * advance;
+            offsets[(char)std::toupper((unsigned char)text[i])].push_back(glm::vec4(x, 0.0f, 0.0f, 0.0f));
+        }
+
+        glPushMatrix();
+        glScalef(1.0f, 1.0f, depth);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        if (program) glUseProgram(program);
+        for (const auto& glyph : offsets) {
+            const GlyphMesh* mesh = get(glyph.first);
+            if (!mesh) continue;
+            glBindBuffer(GL_ARRAY_BUFFER, mesh->buffers[0]);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->buffers[1]);
+            glVertexPointer(3, GL_FLOAT, sizeof(GlyphVertex), (const void*)offsetof(GlyphVertex, position));
+            glNormalPointer(GL_FLOAT, sizeof(GlyphVertex), (const void*)offsetof(GlyphVertex, normal));
+            const std::vector<glm::vec4>& instances = glyph.second;
+            for (size_t first = 0; first < instances.size(); first += MAX_GLYPH_INSTANCES) {
+                GLsizei count = (GLsizei)std::min(instances.size() - first, (size_t)MAX_GLYPH_INSTANCES);
+                if (program) {
+                    glUniform4fv(offsetsLocation, count, glm::value_ptr(instances[first]));
+                    glDrawElementsInstanced(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, (const void*)0, count);
+                    drawCalls++;
+                } else {
+                    for (GLsizei i = 0; i < count; i++) {
+                        glPushMatrix();
+                        glTranslatef(instances[first + i].x, instances[first + i].y, instances[first + i].z);
+                        glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, (const void*)0);
+                        glPopMatrix();
+                        drawCalls++;
+                    }
+                }
+                vertexCount += mesh->indexCount * count;
+            }
+        }
+        if (program) glUseProgram(0);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glPopMatrix();
+    }
+
+    void destroy() {
+        for (auto& entry : meshes) glDeleteBuffers(2, entry.second.buffers);
+        meshes.clear();
+        if (program) glDeleteProgram(program);
+    }
+};
+
+GlyphCache glyphCache;
+
+// ---------------------------------------------------------------------------------------------------------
+// GPU Pipeline Statistics
+// ---------------------------------------------------------------------------------------------------------
+// The 2D letter draws are bracketed by ARB_pipeline_statistics_query counters, a primitives-generated
+// query and a GL_TIME_ELAPSED query, so the primitive modes are compared on what the GPU processed
+// rather than on vertexCount. There are two sets of queries: a set is read back just before it is
+// reused, two frames after it was issued, and only if the driver reports it available. A set that is
+// still busy is dropped instead of waited for, so the readback never stalls the pipeline.
+enum PipelineCounter {
+    COUNTER_VERTICES,
+    COUNTER_VS_INVOCATIONS,
+    COUNTER_PRIMITIVES,
+    COUNTER_FS_INVOCATIONS,
+    COUNTER_GPU_TIME, // Microseconds
+    COUNTER_COUNT
+};
+const GLenum counterTargets[COUNTER_COUNT] = {
+    GL_VERTICES_SUBMITTED_ARB, GL_VERTEX_SHADER_INVOCATIONS_ARB, GL_PRIMITIVES_GENERATED,
+    GL_FRAGMENT_SHADER_INVOCATIONS_ARB, GL_TIME_ELAPSED
+};
+const char* counterNames[COUNTER_COUNT] = { "Vertices", "VS invoc.", "Primitives", "FS invoc.", "GPU us" };
+const char* primitiveModeNames[PRIM_MODE_COUNT] = { "GL_TRIANGLES", "GL_TRIANGLE_STRIP", "GL_QUADS", "GL_QUAD_STRIP" };
+
+const int STATS_QUERY_SETS = 2;
+const int STATS_COMPARE_FRAMES = 120; // Frames per mode in a comparison run
+
+struct PipelineStats {
+    bool supported[COUNTER_COUNT] = {};
+    GLuint queries[STATS_QUERY_SETS][COUNTER_COUNT] = {};
+    int issuedMode[STATS_QUERY_SETS] = { -1, -1 }; // Mode each set measured, -1 when it holds nothing
+    bool issuedComparing[STATS_QUERY_SETS] = {};
+    int set = 0;
+    bool active = false;
+    int dropped = 0;
+
+    double latest[COUNTER_COUNT] = {};
+    int latestMode = -1;
+
+    // Comparison run: every mode for STATS_COMPARE_FRAMES frames, then restore the user's settings
+    int compareFrame = -1; // -1 when idle
+    bool measuring = false; // This frame's mode was picked by the run, so its counters are averaged
+    PrimitiveMode savedMode = PRIM_TRIANGLES;
+    bool savedShow3D = false;
+    double sums[PRIM_MODE_COUNT][COUNTER_COUNT] = {};
+    int samples[PRIM_MODE_COUNT] = {};
+    bool hasComparison = false;
+
+    void create(bool statistics, bool timer) {
+        if (!glGenQueries || !glBeginQuery || !glGetQueryObjectuiv) return;
+        supported[COUNTER_VERTICES] = supported[COUNTER_VS_INVOCATIONS] = supported[COUNTER_FS_INVOCATIONS] = statistics;
+        supported[COUNTER_PRIMITIVES] = true; // OpenGL 3.0
+        supported[COUNTER_GPU_TIME] = timer && glGetQueryObjectui64v;
+        for (int i = 0; i < STATS_QUERY_SETS; i++) glGenQueries(COUNTER_COUNT, queries[i]);
+    }
+
+    bool available() const { return queries[0][0] != 0; }
+
+    void begin(PrimitiveMode mode) {
+        if (!available()) return;
+        collect(set);
+        for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+            if (supported[counter]) glBeginQuery(counterTargets[counter], queries[set][counter]);
+        }
+        issuedMode[set] = mode;
+        issuedComparing[set] = measuring;
+        active = true;
+    }
+
+    void end() {
+        if (!active) return;
+        for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+            if (supported[counter]) glEndQuery(counterTargets[counter]);
+        }
+        set = (set + 1) % STATS_QUERY_SETS;
+        active = false;
+    }
+
+    void collect(int i) {
+        int mode = issuedMode[i];
+        if (mode < 0) return;
+        issuedMode[i] = -1;
+        for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+            GLuint ready = 1;
+            if (supported[counter]) glGetQueryObjectuiv(queries[i][counter], GL_QUERY_RESULT_AVAILABLE, &ready);
+            if (!ready) {
+                dropped++;
+                return;
+            }
+        }
+        for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+            GLuint64 value = 0;
+            if (supported[counter] && glGetQueryObjectui64v) {
+                glGetQueryObjectui64v(queries[i][counter], GL_QUERY_RESULT, &value);
+            } else if (supported[counter]) {
+                GLuint value32 = 0;
+                glGetQueryObjectuiv(queries[i][counter], GL_QUERY_RESULT, &value32);
+                value = value32;
+            }
+            latest[counter] = counter == COUNTER_GPU_TIME ? value / 1000.0 : (double)value;
+        }
+        latestMode = mode;
+        if (issuedComparing[i]) {
+            for (int counter = 0; counter < COUNTER_COUNT; counter++) sums[mode][counter] += latest[counter];
+            samples[mode]++;
+        }
+    }
+
+    bool comparing() const { return compareFrame >= 0; }
+
+    void startComparison() {
+        if (!available() || comparing()) return;
+        savedMode = currentMode;
+        savedShow3D = show3D;
+        for (int mode = 0; mode < PRIM_MODE_COUNT; mode++) {
+            samples[mode] = 0;
+            for (int counter = 0; counter < COUNTER_COUNT; counter++) sums[mode][counter] = 0.0;
+        }
+        compareFrame = 0;
+    }
+
+    // Pick this frame's mode; the run ends STATS_QUERY_SETS frames late so its last sets are read back,
+    // and the frames drawn meanwhile are not measured
+    void stepComparison() {
+        if (!comparing()) return;
+        const int runFrames = PRIM_MODE_COUNT * STATS_COMPARE_FRAMES;
+        show3D = false;
+        measuring = compareFrame < runFrames;
+        if (measuring) {
+            currentMode = (PrimitiveMode)(compareFrame / STATS_COMPARE_FRAMES);
+        } else if (compareFrame == runFrames + STATS_QUERY_SETS) {
+            currentMode = savedMode;
+            show3D = savedShow3D;
+            compareFrame = -1;
+            hasComparison = true;
+            printComparison();
+            return;
+        }
+        compareFrame++;
+    }
+
+    double average(int mode, int counter) const {
+        return samples[mode] ? sums[mode][counter] / samples[mode] : 0.0;
+    }
+
+    void printComparison() const {
+        std::printf("%-18s %6s", "Primitive mode", "Frames");
+        for (int counter = 0; counter < COUNTER_COUNT; counter++) std::printf(" %10s", counterNames[counter]);
+        std::printf("\n");
+        for (int mode = 0; mode < PRIM_MODE_COUNT; mode++) {
+            std::printf("%-18s %6d", primitiveModeNames[mode], samples[mode]);
+            for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+                if (supported[counter]) std::printf(" %10.1f", average(mode, counter));
+                else std::printf(" %10s", "n/a");
+            }
+            std::printf("\n");
+        }
+        if (dropped) std::printf("(%d busy query sets dropped)\n", dropped);
+    }
+
+    void drawPanel() {
+        if (!available()) {
+            ImGui::TextDisabled("GPU statistics: no query objects");
+            return;
+        }
+        if (!supported[COUNTER_VERTICES]) ImGui::TextDisabled("(no ARB_pipeline_statistics_query)");
+        if (!supported[COUNTER_GPU_TIME]) ImGui::TextDisabled("(no ARB_timer_query)");
+        if (latestMode >= 0) {
+            ImGui::Text("GPU (%s):", primitiveModeNames[latestMode]);
+            for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+                if (supported[counter]) ImGui::Text("  %-10s %.1f", counterNames[counter], latest[counter]);
+            }
+        }
+        ImGui::Text("Busy query sets dropped: %d", dropped);
+        if (comparing()) {
+            ImGui::Text("Comparing modes... %d / %d", compareFrame, PRIM_MODE_COUNT * STATS_COMPARE_FRAMES);
+        } else if (ImGui::Button("Compare Primitive Modes")) {
+            startComparison();
+        }
+        if (hasComparison) {
+            for (int mode = 0; mode < PRIM_MODE_COUNT; mode++) {
+                ImGui::Text("%-17s V %.0f  VS %.0f  P %.0f  FS %.0f  %.1f us", primitiveModeNames[mode],
+                            average(mode, COUNTER_VERTICES), average(mode, COUNTER_VS_INVOCATIONS), average(mode, COUNTER_PRIMITIVES),
+                            average(mode, COUNTER_FS_INVOCATIONS), average(mode, COUNTER_GPU_TIME));
+            }
+        }
+    }
+
+    void destroy() {
+        if (!available()) return;
+        for (int i = 0; i < STATS_QUERY_SETS; i++) glDeleteQueries(COUNTER_COUNT, queries[i]);
+    }
+};
+
+PipelineStats pipelineStats;
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
-int main() {
-    if (!glfwInit())
+int main(int argc, char** argv) {
+    HeadlessOptions headless;
+    bool compareModes = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--compare-modes") {
+            compareModes = true;
+        } else if (!parseHeadlessOption(argc, argv, i, headless)) {
+            std::cout << "Usage: " << argv[0] << " " << HEADLESS_USAGE << " [--compare-modes]" << std::endl;
+            return -1;
+        }
+    }
+    CameraScript cameraScript;
+    if (!headless.cameraScript.empty() && !cameraScript.load(headless.cameraScript)) {
+        std::cout << "Failed to read camera script " << headless.cameraScript << std::endl;
         return -1;
+    }
 
+    // Headless: offscreen EGL context instead of a window (same compatibility context as below)
+    HeadlessContext headlessContext;
+    GLFWwindow* window = NULL;
     const char* glsl_version = "#version 130";
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    // glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); // Use default (compat) for simple GL calls like glBegin
+    if (headless.enabled) {
+        if (!headlessContext.create(headless.width, headless.height, 3, 0, false)) return -1;
+    } else {
+        if (!glfwInit())
+            return -1;
 
-    GLFWwindow* window = glfwCreateWindow(1280, 720, "CG HW1 - YLX", NULL, NULL);
-    if (!window) {
-        glfwTerminate();
-        return -1;
-    }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+        // glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); // Use default (compat) for simple GL calls like glBegin
+
+        window = glfwCreateWindow(1280, 720, "CG HW1 - YLX", NULL, NULL);
+        if (!window) {
+            glfwTerminate();
+            return -1;
+        }
 
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSwapInterval(1); // Enable vsync
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSwapInterval(1); // Enable vsync
+    }
 
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
@@ -261,18 +1068,57 @@ int main() {
     io.IniFilename = NULL; // Disable saving .ini file
     ImGui::StyleColorsDark();
 
-    // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init(glsl_version);
+    // Setup Platform/Renderer backends (headless runs build the panel but never draw it)
+    if (headless.enabled) {
+        unsigned char* fontPixels;
+        int fontWidth, fontHeight;
+        io.Fonts->GetTexDataAsRGBA32(&fontPixels, &fontWidth, &fontHeight);
+        io.DisplaySize = ImVec2((float)headless.width, (float)headless.height);
+        io.DeltaTime = 1.0f / headless.fps;
+    } else {
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init(glsl_version);
+    }
 
-    double lastTime = glfwGetTime();
+    if (!loadOpenGLFunctions(headless.enabled ? HeadlessContext::getProcAddress : glfwGetProcAddress)) {
+        std::cout << "Failed to load the OpenGL buffer object functions" << std::endl;
+        return -1;
+    }
+    letterBatch.create();
+    glyphCache.create();
+    if (headless.enabled) {
+        pipelineStats.create(headlessContext.extensionSupported("GL_ARB_pipeline_statistics_query"),
+                             headlessContext.extensionSupported("GL_ARB_timer_query"));
+    } else {
+        pipelineStats.create(glfwExtensionSupported("GL_ARB_pipeline_statistics_query"), glfwExtensionSupported("GL_ARB_timer_query"));
+    }
+    if (compareModes) {
+        pipelineStats.startComparison();
+        // Headless runs last at least as long as the comparison
+        if (headless.enabled) headless.frames = std::max(headless.frames, PRIM_MODE_COUNT * STATS_COMPARE_FRAMES + STATS_QUERY_SETS + 1);
+    }
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+    double lastTime = headless.enabled ? 0.0 : glfwGetTime();
 
-        double currentTime = glfwGetTime();
-        float deltaTime = (float)(currentTime - lastTime);
-        lastTime = currentTime;
+    for (int frame = 0; headless.enabled ? frame < headless.frames : !glfwWindowShouldClose(window); ++frame) {
+        float deltaTime = 1.0f / headless.fps;
+        if (headless.enabled) {
+            // Script keys: distance, rotx, roty, rotz (degrees), and 0/1 switches 3d, perspective, viewpoint
+            float f = (float)frame;
+            viewD = cameraScript.value("distance", f, viewD);
+            rotationX = cameraScript.value("rotx", f, rotationX);
+            rotationY = cameraScript.value("roty", f, rotationY);
+            rotationZ = cameraScript.value("rotz", f, rotationZ);
+            show3D = cameraScript.value("3d", f, show3D) > 0.5f;
+            usePerspective = cameraScript.value("perspective", f, usePerspective) > 0.5f;
+            viewPoint = cameraScript.value("viewpoint", f, (float)viewPoint) > 0.5f ? 1 : 0;
+        } else {
+            glfwPollEvents();
+
+            double currentTime = glfwGetTime();
+            deltaTime = (float)(currentTime - lastTime);
+            lastTime = currentTime;
+        }
 
         // Update rotation
         if (show3D && autoRotate) {
@@ -287,8 +1133,10 @@ int main() {
         }
 
         // Start the Dear ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
+        if (!headless.enabled) {
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+        }
         ImGui::NewFrame();
 
         ImGui::Begin("Control Panel");
@@ -314,6 +1162,13 @@ int main() {
             ImGui::SliderFloat("Rot X", &rotationX, 0.0f, 360.0f);
             ImGui::SliderFloat("Rot Y", &rotationY, 0.0f, 360.0f);
             ImGui::SliderFloat("Rot Z", &rotationZ, 0.0f, 360.0f);
+
+            ImGui::Separator();
+            ImGui::Text("3D Text");
+            ImGui::InputText("Text", text3D, sizeof(text3D));
+            ImGui::SliderFloat("Depth", &extrusionDepth, 0.02f, 1.0f);
+            ImGui::Text("Glyph cache: %d meshes, %.1f KB, %d builds%s", (int)glyphCache.meshes.size(), glyphCache.bytes / 1024.0f,
+                        glyphCache.builds, glyphCache.program ? "" : " (no instancing)");
         }
 
         ImGui::Separator();
@@ -335,13 +1190,18 @@ int main() {
         if (ImGui::RadioButton("GL_QUADS", currentMode == PRIM_QUADS)) currentMode = PRIM_QUADS;
         if (ImGui::RadioButton("GL_QUAD_STRIP", currentMode == PRIM_QUAD_STRIP)) currentMode = PRIM_QUAD_STRIP;
         
-        ImGui::Text("Vertex Count: %d", vertexCount);
+        ImGui::Text("Vertex Count (CPU): %d", vertexCount);
+        ImGui::Text("Draw Calls: %d (%d vertices in buffers, %s)", drawCalls, letterBatch.uniqueVertices,
+                    letterBatch.primitiveRestart ? "primitive restart" : "multi-draw strips");
+        pipelineStats.drawPanel();
 
         ImGui::End();
+        pipelineStats.stepComparison();
 
         ImGui::Render();
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        int display_w = headless.width, display_h = headless.height;
+        if (headless.enabled) headlessContext.beginFrame();
+        else glfwGetFramebufferSize(window, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
         glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
         glClear(GL_COLOR_BUFFER_BIT);
@@ -382,26 +1242,22 @@ int main() {
 
         // Reset vertex count for this frame
         vertexCount = 0;
+        drawCalls = 0;
 
         if (!show3D) {
-            // Draw Initials: Y L X
-            // Draw Y (Left)
-            glPushMatrix();
-            glTranslatef(-1.2f, 0.0f, 0.0f);
-            drawLetterY();
-            glPopMatrix();
-
-            // Draw L (Center)
-            glPushMatrix();
-            glTranslatef(0.0f, 0.0f, 0.0f);
-            drawLetterL();
-            glPopMatrix();
-
-            // Draw X (Right)
-            glPushMatrix();
-            glTranslatef(1.2f, 0.0f, 0.0f);
-            drawLetterX();
-            glPopMatrix();
+            // Draw Initials: Y (Left), L (Center), X (Right), one draw call each
+            const float letterOffsets[LETTER_COUNT] = { -1.2f, 0.0f, 1.2f };
+            letterBatch.begin();
+            pipelineStats.begin(currentMode);
+            for (int letter = 0; letter < LETTER_COUNT; letter++) {
+                glPushMatrix();
+                glTranslatef(letterOffsets[letter], 0.0f, 0.0f);
+                glColor3f(letterColors[letter].r, letterColors[letter].g, letterColors[letter].b);
+                letterBatch.draw((Letter)letter, currentMode);
+                glPopMatrix();
+            }
+            pipelineStats.end();
+            letterBatch.end();
         } else {
             // Draw 3D Surname Initial (Y)
             // Enable depth test for 3D
@@ -415,18 +1271,37 @@ int main() {
             glRotatef(rotationZ, 0.0f, 0.0f, 1.0f);
 
             // Center is already (0,0,0)
-            drawLetterY3D();
+            glColor3f(1.0f, 0.5f, 0.0f); // Orange for 3D
+            glyphCache.drawString(text3D, extrusionDepth, 1.2f);
             glPopMatrix();
 
             glDisable(GL_DEPTH_TEST);
         }
 
+        if (headless.enabled) {
+            headlessContext.endFrame(frame, headless.outputPrefix);
+            continue;
+        }
+
         // Render ImGui
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         glfwSwapBuffers(window);
     }
 
+    if (headless.enabled) {
+        headlessContext.printTimings();
+        letterBatch.destroy();
+        glyphCache.destroy();
+        pipelineStats.destroy();
+        ImGui::DestroyContext();
+        headlessContext.destroy();
+        return 0;
+    }
+
+    letterBatch.destroy();
+    glyphCache.destroy();
+    pipelineStats.destroy();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -0,0 +1,165 @@
+// Microbenchmark: lab03 vecmath (SSE/AVX2) against glm for the primitives CPU-side animation and
+// culling run through. Prints ns/op for both and the max absolute difference of their results.
+// Built with -DCGHW3_BUILD_BENCHMARKS=ON (off by default, since it fetches glm).
+#include "vecmath.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+const size_t BATCH_SIZE = 1 << 16; // Points per batch, fits in L2
+const int REPEATS = 64;            // Batches per timed run
+const int RUNS = 5;                // Best of
+
+template <typename F>
+double bestNanosecondsPerOp(size_t opsPerRun, F&& run) {
+    double best = 1e30;
+    for (int r = 0; r < RUNS; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / opsPerRun);
+    }
+    return best;
+}
+
+void report(const char* name, double ours, double theirs, float maxError) {
+    std::printf("%-24s %10.3f %10.3f %8.2fx   max |diff| %g\n", name, ours, theirs, theirs / ours, maxError);
+}
+
+glm::mat4 toGlm(const Mat4& m) { return glm::make_mat4(m.value_ptr()); }
+
+float maxDifference(const float* a, const float* b, size_t count) {
+    float maxError = 0.0f;
+    for (size_t i = 0; i < count; ++i) maxError = std::max(maxError, std::fabs(a[i] - b[i]));
+    return maxError;
+}
+
+int main() {
+#if defined(VECMATH_AVX2)
+    const char* path = "AVX2+FMA";
+#elif defined(VECMATH_SSE)
+    const char* path = "SSE2";
+#else
+    const char* path = "scalar";
+#endif
+    std::printf("vecmath path: %s\n", path);
+    std::printf("%-24s %10s %10s %9s\n", "benchmark (ns/op)", "vecmath", "glm", "speedup");
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+    Mat4 model = Mat4::translate(Vec3(1.0f, -2.0f, 0.5f)) * Mat4::rotate(0.3f, Vec3(0.2f, 1.0f, 0.4f)) * Mat4::scale(Vec3(1.5f, 1.0f, 0.75f));
+    Mat4 viewProjection = Mat4::perspective(0.8f, 16.0f / 9.0f, 0.1f, 100.0f) * Mat4::lookAt(Vec3(0, 2, 8), Vec3(0, 0, 0), Vec3(0, 1, 0));
+    glm::mat4 glmModel = toGlm(model);
+    glm::mat4 glmViewProjection = toGlm(viewProjection);
+
+    // Mat4 * Mat4: per-object model-view-projection
+    {
+        std::vector<Mat4> models(BATCH_SIZE), results(BATCH_SIZE);
+        std::vector<glm::mat4> glmModels(BATCH_SIZE), glmResults(BATCH_SIZE);
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            models[i] = Mat4::translate(Vec3(dist(rng), dist(rng), dist(rng))) * Mat4::rotate(dist(rng), Vec3(0.5f, 1.0f, 0.0f));
+            glmModels[i] = toGlm(models[i]);
+        }
+        double ours = bestNanosecondsPerOp(BATCH_SIZE * REPEATS, [&] {
+            for (int r = 0; r < REPEATS; ++r)
+                for (size_t i = 0; i < BATCH_SIZE; ++i) results[i] = viewProjection * models[i];
+        });
+        double theirs = bestNanosecondsPerOp(BATCH_SIZE * REPEATS, [&] {
+            for (int r = 0; r < REPEATS; ++r)
+                for (size_t i = 0; i < BATCH_SIZE; ++i) glmResults[i] = glmViewProjection * glmModels[i];
+        });
+        report("Mat4 * Mat4", ours, theirs, maxDifference(results[0].value_ptr(), glm::value_ptr(glmResults[0]), BATCH_SIZE * 16));
+    }
+
+    // Mat4 * Vec4: clip-space transform
+    {
+        std::vector<Vec4> points(BATCH_SIZE), results(BATCH_SIZE);
+        std::vector<glm::vec4> glmPoints(BATCH_SIZE), glmResults(BATCH_SIZE);
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            points[i] = Vec4(dist(rng), dist(rng), dist(rng), 1.0f);
+            glmPoints[i] = glm::vec4(points[i].x, points[i].y, points[i].z, 1.0f);
+        }
+        double ours = bestNanosecondsPerOp(BATCH_SIZE * REPEATS, [&] {
+            for (int r = 0; r < REPEATS; ++r)
+                for (size_t i = 0; i < BATCH_SIZE; ++i) results[i] = viewProjection * points[i];
+        });
+        double theirs = bestNanosecondsPerOp(BATCH_SIZE * REPEATS, [&] {
+            for (int r = 0; r < REPEATS; ++r)
+                for (size_t i = 0; i < BATCH_SIZE; ++i) glmResults[i] = glmViewProjection * glmPoints[i];
+        });
+        report("Mat4 * Vec4", ours, theirs, maxDifference(&results[0].x, glm::value_ptr(glmResults[0]), BATCH_SIZE * 4));
+    }
+
+    // Batch point and normal transforms over packed Vec3 arrays
+    {
+        std::vector<Vec3> points(BATCH_SIZE), results(BATCH_SIZE);
+        std::vector<glm::vec3> glmPoints(BATCH_SIZE), glmResults(BATCH_SIZE);
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            points[i] = Vec3(dist(rng), dist(rng), dist(rng));
+            glmPoints[i] = glm::vec3(points[i].x, points[i].y, points[i].z);
+        }
+
+        double ours = bestNanosecondsPerOp(BATCH_SIZE * REPEATS, [&] {
+            for (int r = 0; r < REPEATS; ++r) transformPoints(model, points.data(), results.data(), BATCH_SIZE);
+        });
+        double theirs = bestNanosecondsPerOp(BATCH_SIZE * REPEATS, [&] {
+            for (int r = 0; r < REPEATS; ++r)
+                for (size_t i = 0; i < BATCH_SIZE; ++i) glmResults[i] = glm::vec3(glmModel * glm::vec4(glmPoints[i], 1.0f));
+        });
+        report("transformPoints", ours, theirs, maxDifference(&results[0].x, glm::value_ptr(glmResults[0]), BATCH_SIZE * 3));
+
+        Mat3 normals = normalMatrix(model);
+        glm::mat3 glmNormals = glm::transpose(glm::inverse(glm::mat3(glmModel)));
+        ours = bestNanosecondsPerOp(BATCH_SIZE * REPEATS, [&] {
+            for (int r = 0; r < REPEATS; ++r) transformNormals(normals, points.data(), results.data(), BATCH_SIZE);
+        });
+        theirs = bestNanosecondsPerOp(BATCH_SIZE * REPEATS, [&] {
+            for (int r = 0; r < REPEATS; ++r)
+                for (size_t i = 0; i < BATCH_SIZE; ++i) glmResults[i] = glmNormals * glmPoints[i];
+        });
+        report("transformNormals", ours, theirs, maxDifference(&results[0].x, glm::value_ptr(glmResults[0]), BATCH_SIZE * 3));
+    }
+
+    // Inverses: a different matrix every iteration, so nothing is loop-invariant
+    {
+        const size_t count = BATCH_SIZE / 16;
+        std::uniform_real_distribution<float> angle(0.0f, 6.28f), scale(0.5f, 2.0f);
+        std::vector<Mat4> projections(count), models(count), results(count);
+        std::vector<glm::mat4> glmProjections(count), glmModels(count), glmResults(count);
+        for (size_t i = 0; i < count; ++i) {
+            Vec3 eye(dist(rng), dist(rng), dist(rng) + 25.0f);
+            projections[i] = Mat4::perspective(0.8f, 16.0f / 9.0f, 0.1f, 100.0f) * Mat4::lookAt(eye, Vec3(0, 0, 0), Vec3(0, 1, 0));
+            models[i] = Mat4::translate(Vec3(dist(rng), dist(rng), dist(rng))) * Mat4::rotate(angle(rng), Vec3(0.2f, 1.0f, 0.4f)) *
+                        Mat4::scale(Vec3(scale(rng), scale(rng), scale(rng)));
+            glmProjections[i] = toGlm(projections[i]);
+            glmModels[i] = toGlm(models[i]);
+        }
+
+        double ours = bestNanosecondsPerOp(count, [&] {
+            for (size_t i = 0; i < count; ++i) results[i] = projections[i].inverse();
+        });
+        double theirs = bestNanosecondsPerOp(count, [&] {
+            for (size_t i = 0; i < count; ++i) glmResults[i] = glm::inverse(glmProjections[i]);
+        });
+        report("Mat4::inverse", ours, theirs, maxDifference(results[0].value_ptr(), glm::value_ptr(glmResults[0]), count * 16));
+
+        ours = bestNanosecondsPerOp(count, [&] {
+            for (size_t i = 0; i < count; ++i) results[i] = models[i].inverseAffine();
+        });
+        theirs = bestNanosecondsPerOp(count, [&] {
+            for (size_t i = 0; i < count; ++i) glmResults[i] = glm::inverse(glmModels[i]);
+        });
+        report("Mat4::inverseAffine", ours, theirs, maxDifference(results[0].value_ptr(), glm::value_ptr(glmResults[0]), count * 16));
+    }
+
+    return 0;
+}
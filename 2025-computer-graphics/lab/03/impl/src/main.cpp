@@ -7,6 +7,20 @@
 #include <string>
 #include <cmath>
 #include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <cstdint>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <random>
+#include <map>
+#include <type_traits>
+#include "vecmath.h"
+#include "headless.h"
 
 // ---------------------------------------------------------------------------------------------------------
 // OpenGL Function Loading (No GLAD/GLEW)
@@ -18,19 +32,62 @@
 #endif
 
 typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+typedef uint64_t GLuint64;
+typedef struct __GLsync *GLsync;
 typedef char GLchar;
 
 // Constants
 #define GL_ARRAY_BUFFER                   0x8892
 #define GL_ELEMENT_ARRAY_BUFFER           0x8893
 #define GL_STATIC_DRAW                    0x88E4
+#define GL_DYNAMIC_DRAW                   0x88E8
+#define GL_UNIFORM_BUFFER                 0x8A11
 #define GL_FRAGMENT_SHADER                0x8B30
 #define GL_VERTEX_SHADER                  0x8B31
 #define GL_COMPILE_STATUS                 0x8B81
 #define GL_LINK_STATUS                    0x8B82
 #define GL_INFO_LOG_LENGTH                0x8B84
+#define GL_ACTIVE_UNIFORMS                0x8B86
+#define GL_ACTIVE_UNIFORM_MAX_LENGTH      0x8B87
+#define GL_FLOAT_VEC3                     0x8B51
+#define GL_FLOAT_MAT3                     0x8B5B
+#define GL_FLOAT_MAT4                     0x8B5C
+#define GL_INVALID_INDEX                  0xFFFFFFFFu
 #define GL_DEPTH_BUFFER_BIT               0x00000100
 #define GL_DEPTH_TEST                     0x0B71
+#define GL_PRIMITIVE_RESTART              0x8F9D
+#define GL_TIME_ELAPSED                   0x88BF
+#define GL_QUERY_RESULT                   0x8866
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH          0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS     0x87FE
+#define GL_MAP_WRITE_BIT                  0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT       0x0004
+#define GL_MAP_INVALIDATE_BUFFER_BIT      0x0008
+#define GL_MAP_UNSYNCHRONIZED_BIT         0x0020
+#define GL_MAP_PERSISTENT_BIT             0x0040
+#define GL_MAP_COHERENT_BIT               0x0080
+#define GL_SYNC_GPU_COMMANDS_COMPLETE     0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT        0x00000001
+#define GL_TIMEOUT_EXPIRED                0x911B
+#define GL_WAIT_FAILED                    0x911D
+#define GL_FRAMEBUFFER                    0x8D40
+#define GL_FRAMEBUFFER_COMPLETE           0x8CD5
+#define GL_COLOR_ATTACHMENT0              0x8CE0
+#define GL_COLOR_ATTACHMENT1              0x8CE1
+#define GL_DEPTH_ATTACHMENT               0x8D00
+#define GL_DEPTH_COMPONENT24              0x81A6
+#define GL_RGBA16F                        0x881A
+#define GL_HALF_FLOAT                     0x140B
+#define GL_TEXTURE0                       0x84C0
+#define GL_SAMPLER_2D                     0x8B5E
+#define GL_MAJOR_VERSION                  0x821B
+#define GL_MINOR_VERSION                  0x821C
+#define GL_DRAW_INDIRECT_BUFFER           0x8F3F
+#define GL_SHADER_STORAGE_BUFFER          0x90D2
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
 
 // Function Pointers
 typedef void (APIENTRY *PFNGLGENBUFFERSPROC) (GLsizei n, GLuint *buffers);
@@ -39,6 +96,7 @@ typedef void (APIENTRY *PFNGLBUFFERDATAPROC) (GLenum target, GLsizeiptr size, co
 typedef void (APIENTRY *PFNGLGENVERTEXARRAYSPROC) (GLsizei n, GLuint *arrays);
 typedef void (APIENTRY *PFNGLBINDVERTEXARRAYPROC) (GLuint array);
 typedef void (APIENTRY *PFNGLENABLEVERTEXATTRIBARRAYPROC) (GLuint index);
+typedef void (APIENTRY *PFNGLDISABLEVERTEXATTRIBARRAYPROC) (GLuint index);
 typedef void (APIENTRY *PFNGLVERTEXATTRIBPOINTERPROC) (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
 typedef GLuint (APIENTRY *PFNGLCREATESHADERPROC) (GLenum type);
 typedef void (APIENTRY *PFNGLSHADERSOURCEPROC) (GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length);
@@ -54,14 +112,51 @@ typedef void (APIENTRY *PFNGLUSEPROGRAMPROC) (GLuint program);
 typedef void (APIENTRY *PFNGLDELETESHADERPROC) (GLuint shader);
 typedef void (APIENTRY *PFNGLDELETEPROGRAMPROC) (GLuint program);
 typedef GLint (APIENTRY *PFNGLGETUNIFORMLOCATIONPROC) (GLuint program, const GLchar *name);
+typedef void (APIENTRY *PFNGLUNIFORM1IPROC) (GLint location, GLint v0);
 typedef void (APIENTRY *PFNGLUNIFORM1FPROC) (GLint location, GLfloat v0);
 typedef void (APIENTRY *PFNGLUNIFORM3FPROC) (GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
 typedef void (APIENTRY *PFNGLUNIFORM3FVPROC) (GLint location, GLsizei count, const GLfloat *value);
 typedef void (APIENTRY *PFNGLUNIFORM4FPROC) (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+typedef void (APIENTRY *PFNGLUNIFORMMATRIX3FVPROC) (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
 typedef void (APIENTRY *PFNGLUNIFORMMATRIX4FVPROC) (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
 typedef void (APIENTRY *PFNGLDELETEVERTEXARRAYSPROC) (GLsizei n, const GLuint *arrays);
 typedef void (APIENTRY *PFNGLDELETEBUFFERSPROC) (GLsizei n, const GLuint *buffers);
 typedef void (APIENTRY *PFNGLVERTEXATTRIB3FPROC) (GLuint index, GLfloat v0, GLfloat v1, GLfloat v2);
+typedef void (APIENTRY *PFNGLPRIMITIVERESTARTINDEXPROC) (GLuint index);
+typedef void (APIENTRY *PFNGLBUFFERSUBDATAPROC) (GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
+typedef void (APIENTRY *PFNGLBINDBUFFERBASEPROC) (GLenum target, GLuint index, GLuint buffer);
+typedef void (APIENTRY *PFNGLGETACTIVEUNIFORMPROC) (GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name);
+typedef GLuint (APIENTRY *PFNGLGETUNIFORMBLOCKINDEXPROC) (GLuint program, const GLchar *uniformBlockName);
+typedef void (APIENTRY *PFNGLUNIFORMBLOCKBINDINGPROC) (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding);
+typedef void (APIENTRY *PFNGLVERTEXATTRIBDIVISORPROC) (GLuint index, GLuint divisor);
+typedef void (APIENTRY *PFNGLDRAWARRAYSINSTANCEDPROC) (GLenum mode, GLint first, GLsizei count, GLsizei instancecount);
+typedef void (APIENTRY *PFNGLMULTIDRAWELEMENTSBASEVERTEXPROC) (GLenum mode, const GLsizei *count, GLenum type, const void *const*indices, GLsizei drawcount, const GLint *basevertex);
+typedef void (APIENTRY *PFNGLGENQUERIESPROC) (GLsizei n, GLuint *ids);
+typedef void (APIENTRY *PFNGLDELETEQUERIESPROC) (GLsizei n, const GLuint *ids);
+typedef void (APIENTRY *PFNGLBEGINQUERYPROC) (GLenum target, GLuint id);
+typedef void (APIENTRY *PFNGLENDQUERYPROC) (GLenum target);
+typedef void (APIENTRY *PFNGLGETQUERYOBJECTUI64VPROC) (GLuint id, GLenum pname, GLuint64 *params);
+typedef void (APIENTRY *PFNGLBINDBUFFERRANGEPROC) (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+typedef void (APIENTRY *PFNGLBUFFERSTORAGEPROC) (GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void *(APIENTRY *PFNGLMAPBUFFERRANGEPROC) (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (APIENTRY *PFNGLUNMAPBUFFERPROC) (GLenum target);
+typedef GLsync (APIENTRY *PFNGLFENCESYNCPROC) (GLenum condition, GLbitfield flags);
+typedef void (APIENTRY *PFNGLDELETESYNCPROC) (GLsync sync);
+typedef GLenum (APIENTRY *PFNGLCLIENTWAITSYNCPROC) (GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void (APIENTRY *PFNGLGETPROGRAMBINARYPROC) (GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRY *PFNGLPROGRAMBINARYPROC) (GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRY *PFNGLPROGRAMPARAMETERIPROC) (GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRY *PFNGLDRAWELEMENTSINSTANCEDPROC) (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount);
+typedef void (APIENTRY *PFNGLGENFRAMEBUFFERSPROC) (GLsizei n, GLuint *framebuffers);
+typedef void (APIENTRY *PFNGLDELETEFRAMEBUFFERSPROC) (GLsizei n, const GLuint *framebuffers);
+typedef void (APIENTRY *PFNGLBINDFRAMEBUFFERPROC) (GLenum target, GLuint framebuffer);
+typedef void (APIENTRY *PFNGLFRAMEBUFFERTEXTURE2DPROC) (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+typedef GLenum (APIENTRY *PFNGLCHECKFRAMEBUFFERSTATUSPROC) (GLenum target);
+typedef void (APIENTRY *PFNGLDRAWBUFFERSPROC) (GLsizei n, const GLenum *bufs);
+typedef void (APIENTRY *PFNGLMULTIDRAWELEMENTSINDIRECTPROC) (GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+#ifdef _WIN32
+typedef void (APIENTRY *PFNGLACTIVETEXTUREPROC) (GLenum texture);
+#endif
 
 PFNGLGENBUFFERSPROC glGenBuffers = NULL;
 PFNGLBINDBUFFERPROC glBindBuffer = NULL;
@@ -69,6 +164,7 @@ PFNGLBUFFERDATAPROC glBufferData = NULL;
 PFNGLGENVERTEXARRAYSPROC glGenVertexArrays = NULL;
 PFNGLBINDVERTEXARRAYPROC glBindVertexArray = NULL;
 PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray = NULL;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray = NULL;
 PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer = NULL;
 PFNGLCREATESHADERPROC glCreateShader = NULL;
 PFNGLSHADERSOURCEPROC glShaderSource = NULL;
@@ -84,45 +180,120 @@ PFNGLUSEPROGRAMPROC glUseProgram = NULL;
 PFNGLDELETESHADERPROC glDeleteShader = NULL;
 PFNGLDELETEPROGRAMPROC glDeleteProgram = NULL;
 PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation = NULL;
+PFNGLUNIFORM1IPROC glUniform1i = NULL;
 PFNGLUNIFORM1FPROC glUniform1f = NULL;
 PFNGLUNIFORM3FPROC glUniform3f = NULL;
 PFNGLUNIFORM3FVPROC glUniform3fv = NULL;
 PFNGLUNIFORM4FPROC glUniform4f = NULL;
+PFNGLUNIFORMMATRIX3FVPROC glUniformMatrix3fv = NULL;
 PFNGLUNIFORMMATRIX4FVPROC glUniformMatrix4fv = NULL;
 PFNGLDELETEVERTEXARRAYSPROC glDeleteVertexArrays = NULL;
 PFNGLDELETEBUFFERSPROC glDeleteBuffers = NULL;
 PFNGLVERTEXATTRIB3FPROC glVertexAttrib3f = NULL;
+PFNGLPRIMITIVERESTARTINDEXPROC glPrimitiveRestartIndex = NULL;
+PFNGLBUFFERSUBDATAPROC glBufferSubData = NULL;
+PFNGLBINDBUFFERBASEPROC glBindBufferBase = NULL;
+PFNGLGETACTIVEUNIFORMPROC glGetActiveUniform = NULL;
+PFNGLGETUNIFORMBLOCKINDEXPROC glGetUniformBlockIndex = NULL;
+PFNGLUNIFORMBLOCKBINDINGPROC glUniformBlockBinding = NULL;
+PFNGLVERTEXATTRIBDIVISORPROC glVertexAttribDivisor = NULL;
+PFNGLDRAWARRAYSINSTANCEDPROC glDrawArraysInstanced = NULL;
+PFNGLDRAWELEMENTSINSTANCEDPROC glDrawElementsInstanced = NULL;
+PFNGLMULTIDRAWELEMENTSBASEVERTEXPROC glMultiDrawElementsBaseVertex = NULL;
+PFNGLGENQUERIESPROC glGenQueries = NULL;
+PFNGLDELETEQUERIESPROC glDeleteQueries = NULL;
+PFNGLBEGINQUERYPROC glBeginQuery = NULL;
+PFNGLENDQUERYPROC glEndQuery = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v = NULL;
+PFNGLBINDBUFFERRANGEPROC glBindBufferRange = NULL;
+PFNGLBUFFERSTORAGEPROC glBufferStorage = NULL; // GL 4.4 / ARB_buffer_storage, may be missing
+PFNGLMAPBUFFERRANGEPROC glMapBufferRange = NULL;
+PFNGLUNMAPBUFFERPROC glUnmapBuffer = NULL;
+PFNGLFENCESYNCPROC glFenceSync = NULL;
+PFNGLDELETESYNCPROC glDeleteSync = NULL;
+PFNGLCLIENTWAITSYNCPROC glClientWaitSync = NULL;
+PFNGLGETPROGRAMBINARYPROC glGetProgramBinary = NULL;   // GL 4.1 / ARB_get_program_binary, may be missing
+PFNGLPROGRAMBINARYPROC glProgramBinary = NULL;
+PFNGLPROGRAMPARAMETERIPROC glProgramParameteri = NULL;
+PFNGLGENFRAMEBUFFERSPROC glGenFramebuffers = NULL;
+PFNGLDELETEFRAMEBUFFERSPROC glDeleteFramebuffers = NULL;
+PFNGLBINDFRAMEBUFFERPROC glBindFramebuffer = NULL;
+PFNGLFRAMEBUFFERTEXTURE2DPROC glFramebufferTexture2D = NULL;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC glCheckFramebufferStatus = NULL;
+PFNGLDRAWBUFFERSPROC glDrawBuffers = NULL;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glMultiDrawElementsIndirect = NULL; // GL 4.3, may be missing
+#ifdef _WIN32
+PFNGLACTIVETEXTUREPROC glActiveTexture = NULL; // OpenGL 1.3, exported by other platforms' gl.h
+#endif
 
-void loadOpenGLFunctions() {
-    glGenBuffers = (PFNGLGENBUFFERSPROC)glfwGetProcAddress("glGenBuffers");
-    glBindBuffer = (PFNGLBINDBUFFERPROC)glfwGetProcAddress("glBindBuffer");
-    glBufferData = (PFNGLBUFFERDATAPROC)glfwGetProcAddress("glBufferData");
-    glGenVertexArrays = (PFNGLGENVERTEXARRAYSPROC)glfwGetProcAddress("glGenVertexArrays");
-    glBindVertexArray = (PFNGLBINDVERTEXARRAYPROC)glfwGetProcAddress("glBindVertexArray");
-    glEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC)glfwGetProcAddress("glEnableVertexAttribArray");
-    glVertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC)glfwGetProcAddress("glVertexAttribPointer");
-    glCreateShader = (PFNGLCREATESHADERPROC)glfwGetProcAddress("glCreateShader");
-    glShaderSource = (PFNGLSHADERSOURCEPROC)glfwGetProcAddress("glShaderSource");
-    glCompileShader = (PFNGLCOMPILESHADERPROC)glfwGetProcAddress("glCompileShader");
-    glGetShaderiv = (PFNGLGETSHADERIVPROC)glfwGetProcAddress("glGetShaderiv");
-    glGetShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC)glfwGetProcAddress("glGetShaderInfoLog");
-    glCreateProgram = (PFNGLCREATEPROGRAMPROC)glfwGetProcAddress("glCreateProgram");
-    glAttachShader = (PFNGLATTACHSHADERPROC)glfwGetProcAddress("glAttachShader");
-    glLinkProgram = (PFNGLLINKPROGRAMPROC)glfwGetProcAddress("glLinkProgram");
-    glGetProgramiv = (PFNGLGETPROGRAMIVPROC)glfwGetProcAddress("glGetProgramiv");
-    glGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)glfwGetProcAddress("glGetProgramInfoLog");
-    glUseProgram = (PFNGLUSEPROGRAMPROC)glfwGetProcAddress("glUseProgram");
-    glDeleteShader = (PFNGLDELETESHADERPROC)glfwGetProcAddress("glDeleteShader");
-    glDeleteProgram = (PFNGLDELETEPROGRAMPROC)glfwGetProcAddress("glDeleteProgram");
-    glGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)glfwGetProcAddress("glGetUniformLocation");
-    glUniform1f = (PFNGLUNIFORM1FPROC)glfwGetProcAddress("glUniform1f");
-    glUniform3f = (PFNGLUNIFORM3FPROC)glfwGetProcAddress("glUniform3f");
-    glUniform3fv = (PFNGLUNIFORM3FVPROC)glfwGetProcAddress("glUniform3fv");
-    glUniform4f = (PFNGLUNIFORM4FPROC)glfwGetProcAddress("glUniform4f");
-    glUniformMatrix4fv = (PFNGLUNIFORMMATRIX4FVPROC)glfwGetProcAddress("glUniformMatrix4fv");
-    glDeleteVertexArrays = (PFNGLDELETEVERTEXARRAYSPROC)glfwGetProcAddress("glDeleteVertexArrays");
-    glDeleteBuffers = (PFNGLDELETEBUFFERSPROC)glfwGetProcAddress("glDeleteBuffers");
-    glVertexAttrib3f = (PFNGLVERTEXATTRIB3FPROC)glfwGetProcAddress("glVertexAttrib3f");
+void loadOpenGLFunctions(HeadlessProc (*getProcAddress)(const char*)) {
+    glGenBuffers = (PFNGLGENBUFFERSPROC)getProcAddress("glGenBuffers");
+    glBindBuffer = (PFNGLBINDBUFFERPROC)getProcAddress("glBindBuffer");
+    glBufferData = (PFNGLBUFFERDATAPROC)getProcAddress("glBufferData");
+    glGenVertexArrays = (PFNGLGENVERTEXARRAYSPROC)getProcAddress("glGenVertexArrays");
+    glBindVertexArray = (PFNGLBINDVERTEXARRAYPROC)getProcAddress("glBindVertexArray");
+    glEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC)getProcAddress("glEnableVertexAttribArray");
+    glDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)getProcAddress("glDisableVertexAttribArray");
+    glVertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC)getProcAddress("glVertexAttribPointer");
+    glCreateShader = (PFNGLCREATESHADERPROC)getProcAddress("glCreateShader");
+    glShaderSource = (PFNGLSHADERSOURCEPROC)getProcAddress("glShaderSource");
+    glCompileShader = (PFNGLCOMPILESHADERPROC)getProcAddress("glCompileShader");
+    glGetShaderiv = (PFNGLGETSHADERIVPROC)getProcAddress("glGetShaderiv");
+    glGetShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC)getProcAddress("glGetShaderInfoLog");
+    glCreateProgram = (PFNGLCREATEPROGRAMPROC)getProcAddress("glCreateProgram");
+    glAttachShader = (PFNGLATTACHSHADERPROC)getProcAddress("glAttachShader");
+    glLinkProgram = (PFNGLLINKPROGRAMPROC)getProcAddress("glLinkProgram");
+    glGetProgramiv = (PFNGLGETPROGRAMIVPROC)getProcAddress("glGetProgramiv");
+    glGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)getProcAddress("glGetProgramInfoLog");
+    glUseProgram = (PFNGLUSEPROGRAMPROC)getProcAddress("glUseProgram");
+    glDeleteShader = (PFNGLDELETESHADERPROC)getProcAddress("glDeleteShader");
+    glDeleteProgram = (PFNGLDELETEPROGRAMPROC)getProcAddress("glDeleteProgram");
+    glGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)getProcAddress("glGetUniformLocation");
+    glUniform1i = (PFNGLUNIFORM1IPROC)getProcAddress("glUniform1i");
+    glUniform1f = (PFNGLUNIFORM1FPROC)getProcAddress("glUniform1f");
+    glUniform3f = (PFNGLUNIFORM3FPROC)getProcAddress("glUniform3f");
+    glUniform3fv = (PFNGLUNIFORM3FVPROC)getProcAddress("glUniform3fv");
+    glUniform4f = (PFNGLUNIFORM4FPROC)getProcAddress("glUniform4f");
+    glUniformMatrix3fv = (PFNGLUNIFORMMATRIX3FVPROC)getProcAddress("glUniformMatrix3fv");
+    glUniformMatrix4fv = (PFNGLUNIFORMMATRIX4FVPROC)getProcAddress("glUniformMatrix4fv");
+    glDeleteVertexArrays = (PFNGLDELETEVERTEXARRAYSPROC)getProcAddress("glDeleteVertexArrays");
+    glDeleteBuffers = (PFNGLDELETEBUFFERSPROC)getProcAddress("glDeleteBuffers");
+    glVertexAttrib3f = (PFNGLVERTEXATTRIB3FPROC)getProcAddress("glVertexAttrib3f");
+    glPrimitiveRestartIndex = (PFNGLPRIMITIVERESTARTINDEXPROC)getProcAddress("glPrimitiveRestartIndex");
+    glBufferSubData = (PFNGLBUFFERSUBDATAPROC)getProcAddress("glBufferSubData");
+    glBindBufferBase = (PFNGLBINDBUFFERBASEPROC)getProcAddress("glBindBufferBase");
+    glGetActiveUniform = (PFNGLGETACTIVEUNIFORMPROC)getProcAddress("glGetActiveUniform");
+    glGetUniformBlockIndex = (PFNGLGETUNIFORMBLOCKINDEXPROC)getProcAddress("glGetUniformBlockIndex");
+    glUniformBlockBinding = (PFNGLUNIFORMBLOCKBINDINGPROC)getProcAddress("glUniformBlockBinding");
+    glVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)getProcAddress("glVertexAttribDivisor");
+    glDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDPROC)getProcAddress("glDrawArraysInstanced");
+    glDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDPROC)getProcAddress("glDrawElementsInstanced");
+    glMultiDrawElementsBaseVertex = (PFNGLMULTIDRAWELEMENTSBASEVERTEXPROC)getProcAddress("glMultiDrawElementsBaseVertex");
+    glGenQueries = (PFNGLGENQUERIESPROC)getProcAddress("glGenQueries");
+    glDeleteQueries = (PFNGLDELETEQUERIESPROC)getProcAddress("glDeleteQueries");
+    glBeginQuery = (PFNGLBEGINQUERYPROC)getProcAddress("glBeginQuery");
+    glEndQuery = (PFNGLENDQUERYPROC)getProcAddress("glEndQuery");
+    glGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)getProcAddress("glGetQueryObjectui64v");
+    glBindBufferRange = (PFNGLBINDBUFFERRANGEPROC)getProcAddress("glBindBufferRange");
+    glBufferStorage = (PFNGLBUFFERSTORAGEPROC)getProcAddress("glBufferStorage");
+    glMapBufferRange = (PFNGLMAPBUFFERRANGEPROC)getProcAddress("glMapBufferRange");
+    glUnmapBuffer = (PFNGLUNMAPBUFFERPROC)getProcAddress("glUnmapBuffer");
+    glFenceSync = (PFNGLFENCESYNCPROC)getProcAddress("glFenceSync");
+    glDeleteSync = (PFNGLDELETESYNCPROC)getProcAddress("glDeleteSync");
+    glClientWaitSync = (PFNGLCLIENTWAITSYNCPROC)getProcAddress("glClientWaitSync");
+    glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)getProcAddress("glGetProgramBinary");
+    glProgramBinary = (PFNGLPROGRAMBINARYPROC)getProcAddress("glProgramBinary");
+    glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)getProcAddress("glProgramParameteri");
+    glGenFramebuffers = (PFNGLGENFRAMEBUFFERSPROC)getProcAddress("glGenFramebuffers");
+    glDeleteFramebuffers = (PFNGLDELETEFRAMEBUFFERSPROC)getProcAddress("glDeleteFramebuffers");
+    glBindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC)getProcAddress("glBindFramebuffer");
+    glFramebufferTexture2D = (PFNGLFRAMEBUFFERTEXTURE2DPROC)getProcAddress("glFramebufferTexture2D");
+    glCheckFramebufferStatus = (PFNGLCHECKFRAMEBUFFERSTATUSPROC)getProcAddress("glCheckFramebufferStatus");
+    glDrawBuffers = (PFNGLDRAWBUFFERSPROC)getProcAddress("glDrawBuffers");
+    glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)getProcAddress("glMultiDrawElementsIndirect");
+#ifdef _WIN32
+    glActiveTexture = (PFNGLACTIVETEXTUREPROC)getProcAddress("glActiveTexture");
+#endif
 
     if (!glGenBuffers || !glCreateShader || !glUniformMatrix4fv) {
         std::cerr << "ERROR: Failed to load OpenGL functions." << std::endl;
@@ -131,192 +302,661 @@ void loadOpenGLFunctions() {
 }
 
 // ---------------------------------------------------------------------------------------------------------
-// Minimal Math Library (No GLM)
+// GL Call Tracing (CGHW3_GL_TRACE builds)
 // ---------------------------------------------------------------------------------------------------------
-const float PI = 3.14159265359f;
+// Replaces every pointer loaded above with a trampoline that calls the real entry point and records,
+// per frame and per entry point: the call count, the CPU time spent inside the call, and calls that
+// re-set state the driver already has (the same program, VAO, buffer binding or uniform value).
+// Calls slower than GL_TRACE_STALL_MS are logged as stalls, which catches synchronous waits on the GPU
+// (fences, query results, mapping a buffer still in use). Core GL 1.x functions from gl.h and the ImGui
+// backend's own loader are not seen. Redundancy is tracked across frames and reset on delete/link,
+// since ids can be reused. Set CGHW3_GL_TRACE_DUMP=<file.csv> to dump every frame's counters.
+#ifdef CGHW3_GL_TRACE
+const double GL_TRACE_STALL_MS = 0.5;
+const size_t GL_TRACE_MAX_STALLS = 32; // Per frame, the rest are only counted
+
+enum GLTraceState {
+    TRACE_NONE,       // No state worth comparing (draws, queries, creation)
+    TRACE_PROGRAM,    // glUseProgram(program)
+    TRACE_VAO,        // glBindVertexArray(vao)
+    TRACE_BINDING,    // glBindBuffer / glBindFramebuffer(target, object): the target names the slot (per VAO for indices)
+    TRACE_INDEXED,    // glBindBufferBase / Range(target, index, ...): first two arguments name the slot
+    TRACE_UNIFORM,    // glUniform*(location, ...): slot is (current program, location)
+    TRACE_INVALIDATE  // Deletes and links can recycle ids or reset uniforms: forget everything
+};
+
+struct GLTraceEntry {
+    const char* name;
+    GLTraceState state;
+    size_t pointerBytes; // Bytes behind a uniform value pointer, per counted element
+    unsigned int calls = 0;
+    unsigned int redundant = 0;
+    double cpuMs = 0.0;
+    double maxMs = 0.0;
+};
 
-struct Vec3 {
-    float x, y, z;
+struct GLTraceStall {
+    const char* name;
+    double ms;
+};
 
-    Vec3() : x(0), y(0), z(0) {}
-    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+struct GLTrace {
+    std::vector<GLTraceEntry> entries;  // Current frame
+    std::vector<GLTraceEntry> lastFrame;
+    std::vector<GLTraceStall> stalls;   // Current frame
+    std::vector<GLTraceStall> lastStalls;
+    unsigned int stallCount = 0;
+    unsigned int lastStallCount = 0;
+    std::map<std::string, std::string> state; // Slot bytes -> last value bytes
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    long long frame = 0;
+    std::ofstream dump;
+
+    // Pack the arguments into the slot key and the value; pointers contribute the data they point to
+    struct Packer {
+        std::string slot;
+        std::string value;
+        int slotArgs;
+        size_t pointerBytes;
+        GLsizei count = 1; // Last GLsizei seen: the element count of a following value pointer
+
+        template <typename T> void add(T arg) {
+            std::string& out = slotArgs > 0 ? slot : value;
+            --slotArgs;
+            if constexpr (std::is_pointer<T>::value) {
+                if (arg && pointerBytes) out.append((const char*)arg, pointerBytes * (size_t)std::max(count, 0));
+            } else {
+                if constexpr (std::is_same<T, GLsizei>::value) count = arg;
+                out.append((const char*)&arg, sizeof(T));
+            }
+        }
+    };
 
-    Vec3 operator+(const Vec3& other) const { return Vec3(x + other.x, y + other.y, z + other.z); }
-    Vec3 operator-(const Vec3& other) const { return Vec3(x - other.x, y - other.y, z - other.z); }
-    Vec3 operator*(float scalar) const { return Vec3(x * scalar, y * scalar, z * scalar); }
-    Vec3 operator/(float scalar) const { return Vec3(x / scalar, y / scalar, z / scalar); }
+    template <typename... Args> bool redundant(GLTraceEntry& entry, Args... args) {
+        if (entry.state == TRACE_NONE) return false;
+        if (entry.state == TRACE_INVALIDATE) {
+            state.clear();
+            return false;
+        }
+        int slotArgs = entry.state == TRACE_BINDING || entry.state == TRACE_UNIFORM ? 1 : entry.state == TRACE_INDEXED ? 2 : 0;
+        Packer packer = { std::string(1, (char)entry.state), std::string(), slotArgs, entry.pointerBytes };
+        if (entry.state == TRACE_UNIFORM) packer.slot.append((const char*)&program, sizeof(program));
+        (packer.add(args), ...);
+        if (entry.state == TRACE_PROGRAM) std::memcpy(&program, packer.value.data(), sizeof(program));
+        if (entry.state == TRACE_VAO) std::memcpy(&vertexArray, packer.value.data(), sizeof(vertexArray));
+        GLenum target = 0;
+        if (entry.state == TRACE_BINDING) std::memcpy(&target, packer.slot.data() + 1, sizeof(target));
+        if (target == GL_ELEMENT_ARRAY_BUFFER) packer.slot.append((const char*)&vertexArray, sizeof(vertexArray));
+
+        auto it = state.find(packer.slot);
+        if (it != state.end() && it->second == packer.value) return true;
+        state[packer.slot] = packer.value;
+        return false;
+    }
 
-    float dot(const Vec3& other) const { return x * other.x + y * other.y + z * other.z; }
-    
-    Vec3 cross(const Vec3& other) const {
-        return Vec3(
-            y * other.z - z * other.y,
-            z * other.x - x * other.z,
-            x * other.y - y * other.x
-        );
+    void record(GLTraceEntry& entry, double ms) {
+        ++entry.calls;
+        entry.cpuMs += ms;
+        entry.maxMs = std::max(entry.maxMs, ms);
+        if (ms < GL_TRACE_STALL_MS) return;
+        ++stallCount;
+        if (stalls.size() < GL_TRACE_MAX_STALLS) stalls.push_back({ entry.name, ms });
     }
 
-    float length() const { return std::sqrt(x * x + y * y + z * z); }
+    // Publish this frame's counters to the overlay (and the dump), then start the next frame
+    void endFrame() {
+        if (entries.empty()) return;
+        if (dump.is_open()) {
+            for (const GLTraceEntry& entry : entries) {
+                if (entry.calls == 0) continue;
+                dump << frame << "," << entry.name << "," << entry.calls << "," << entry.redundant << ","
+                     << entry.cpuMs * 1000.0 << "," << entry.maxMs * 1000.0 << "\n";
+            }
+            for (const GLTraceStall& stall : stalls) dump << frame << ",stall:" << stall.name << ",1,0," << stall.ms * 1000.0 << "," << stall.ms * 1000.0 << "\n";
+        }
+        lastFrame = entries;
+        lastStalls.swap(stalls);
+        stalls.clear();
+        lastStallCount = stallCount;
+        stallCount = 0;
+        for (GLTraceEntry& entry : entries) {
+            entry.calls = entry.redundant = 0;
+            entry.cpuMs = entry.maxMs = 0.0;
+        }
+        ++frame;
+    }
 
-    Vec3 normalize() const {
-        float len = length();
-        if (len > 0) return *this / len;
-        return *this;
+    void drawOverlay() {
+        if (lastFrame.empty()) return;
+        std::vector<const GLTraceEntry*> called;
+        unsigned int calls = 0, redundantCalls = 0;
+        double cpuMs = 0.0;
+        for (const GLTraceEntry& entry : lastFrame) {
+            if (entry.calls == 0) continue;
+            called.push_back(&entry);
+            calls += entry.calls;
+            redundantCalls += entry.redundant;
+            cpuMs += entry.cpuMs;
+        }
+        std::sort(called.begin(), called.end(), [](const GLTraceEntry* a, const GLTraceEntry* b) { return a->cpuMs > b->cpuMs; });
+
+        ImGui::Begin("GL Calls");
+        ImGui::Text("Frame %lld: %u calls, %u redundant, %.3f ms in the driver", frame - 1, calls, redundantCalls, cpuMs);
+        ImGui::Text("Stalls over %.1f ms: %u", GL_TRACE_STALL_MS, lastStallCount);
+        for (const GLTraceStall& stall : lastStalls) ImGui::TextDisabled("  %s %.3f ms", stall.name, stall.ms);
+        ImGui::Separator();
+        ImGui::Text("%-28s %7s %7s %9s %9s", "entry point", "calls", "redund.", "cpu us", "max us");
+        for (const GLTraceEntry* entry : called) {
+            ImGui::Text("%-28s %7u %7u %9.1f %9.1f", entry->name, entry->calls, entry->redundant, entry->cpuMs * 1000.0, entry->maxMs * 1000.0);
+        }
+        ImGui::End();
     }
 };
 
-struct Mat4 {
-    float m[4][4]; // Column-major: m[col][row]
+GLTrace glTrace;
+
+// One instantiation per wrapped pointer (Id keeps entry points that share a signature apart)
+template <int Id, typename R, typename... Args> struct GLTracedCall {
+    static R (APIENTRY *real)(Args...);
+    static size_t entry;
 
-    Mat4() {
-        for (int i = 0; i < 4; ++i)
-            for (int j = 0; j < 4; ++j)
-                m[i][j] = (i == j) ? 1.0f : 0.0f;
+    static R APIENTRY call(Args... args) {
+        GLTraceEntry& traced = glTrace.entries[entry];
+        if (glTrace.redundant(traced, args...)) ++traced.redundant;
+        auto start = std::chrono::steady_clock::now();
+        if constexpr (std::is_void<R>::value) {
+            real(args...);
+            glTrace.record(traced, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        } else {
+            R result = real(args...);
+            glTrace.record(traced, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            return result;
+        }
     }
+};
+template <int Id, typename R, typename... Args> R (APIENTRY *GLTracedCall<Id, R, Args...>::real)(Args...) = NULL;
+template <int Id, typename R, typename... Args> size_t GLTracedCall<Id, R, Args...>::entry = 0;
+
+template <int Id, typename R, typename... Args>
+void traceGLFunction(R (APIENTRY *&pointer)(Args...), const char* name, GLTraceState state, size_t pointerBytes = 0) {
+    if (!pointer) return; // Optional entry points stay NULL so feature checks still work
+    GLTracedCall<Id, R, Args...>::real = pointer;
+    GLTracedCall<Id, R, Args...>::entry = glTrace.entries.size();
+    glTrace.entries.push_back({ name, state, pointerBytes });
+    pointer = &GLTracedCall<Id, R, Args...>::call;
+}
 
-    static Mat4 identity() { return Mat4(); }
+#define TRACE_GL(function, ...) traceGLFunction<__COUNTER__>(function, #function, __VA_ARGS__)
+
+void traceOpenGLFunctions() {
+    TRACE_GL(glGenBuffers, TRACE_NONE);
+    TRACE_GL(glBindBuffer, TRACE_BINDING);
+    TRACE_GL(glBufferData, TRACE_NONE);
+    TRACE_GL(glGenVertexArrays, TRACE_NONE);
+    TRACE_GL(glBindVertexArray, TRACE_VAO);
+    TRACE_GL(glEnableVertexAttribArray, TRACE_NONE);
+    TRACE_GL(glDisableVertexAttribArray, TRACE_NONE);
+    TRACE_GL(glVertexAttribPointer, TRACE_NONE);
+    TRACE_GL(glCreateShader, TRACE_NONE);
+    TRACE_GL(glShaderSource, TRACE_NONE);
+    TRACE_GL(glCompileShader, TRACE_NONE);
+    TRACE_GL(glGetShaderiv, TRACE_NONE);
+    TRACE_GL(glGetShaderInfoLog, TRACE_NONE);
+    TRACE_GL(glCreateProgram, TRACE_NONE);
+    TRACE_GL(glAttachShader, TRACE_NONE);
+    TRACE_GL(glLinkProgram, TRACE_INVALIDATE);
+    TRACE_GL(glGetProgramiv, TRACE_NONE);
+    TRACE_GL(glGetProgramInfoLog, TRACE_NONE);
+    TRACE_GL(glUseProgram, TRACE_PROGRAM);
+    TRACE_GL(glDeleteShader, TRACE_NONE);
+    TRACE_GL(glDeleteProgram, TRACE_INVALIDATE);
+    TRACE_GL(glGetUniformLocation, TRACE_NONE);
+    TRACE_GL(glUniform1i, TRACE_UNIFORM);
+    TRACE_GL(glUniform1f, TRACE_UNIFORM);
+    TRACE_GL(glUniform3f, TRACE_UNIFORM);
+    TRACE_GL(glUniform3fv, TRACE_UNIFORM, 3 * sizeof(GLfloat));
+    TRACE_GL(glUniform4f, TRACE_UNIFORM);
+    TRACE_GL(glUniformMatrix3fv, TRACE_UNIFORM, 9 * sizeof(GLfloat));
+    TRACE_GL(glUniformMatrix4fv, TRACE_UNIFORM, 16 * sizeof(GLfloat));
+    TRACE_GL(glDeleteVertexArrays, TRACE_INVALIDATE);
+    TRACE_GL(glDeleteBuffers, TRACE_INVALIDATE);
+    TRACE_GL(glVertexAttrib3f, TRACE_NONE);
+    TRACE_GL(glPrimitiveRestartIndex, TRACE_NONE);
+    TRACE_GL(glBufferSubData, TRACE_NONE);
+    TRACE_GL(glBindBufferBase, TRACE_INDEXED);
+    TRACE_GL(glGetActiveUniform, TRACE_NONE);
+    TRACE_GL(glGetUniformBlockIndex, TRACE_NONE);
+    TRACE_GL(glUniformBlockBinding, TRACE_NONE);
+    TRACE_GL(glVertexAttribDivisor, TRACE_NONE);
+    TRACE_GL(glDrawArraysInstanced, TRACE_NONE);
+    TRACE_GL(glDrawElementsInstanced, TRACE_NONE);
+    TRACE_GL(glMultiDrawElementsBaseVertex, TRACE_NONE);
+    TRACE_GL(glGenQueries, TRACE_NONE);
+    TRACE_GL(glDeleteQueries, TRACE_NONE);
+    TRACE_GL(glBeginQuery, TRACE_NONE);
+    TRACE_GL(glEndQuery, TRACE_NONE);
+    TRACE_GL(glGetQueryObjectui64v, TRACE_NONE);
+    TRACE_GL(glBindBufferRange, TRACE_INDEXED);
+    TRACE_GL(glBufferStorage, TRACE_NONE);
+    TRACE_GL(glMapBufferRange, TRACE_NONE);
+    TRACE_GL(glUnmapBuffer, TRACE_NONE);
+    TRACE_GL(glFenceSync, TRACE_NONE);
+    TRACE_GL(glDeleteSync, TRACE_NONE);
+    TRACE_GL(glClientWaitSync, TRACE_NONE);
+    TRACE_GL(glGetProgramBinary, TRACE_NONE);
+    TRACE_GL(glProgramBinary, TRACE_INVALIDATE);
+    TRACE_GL(glProgramParameteri, TRACE_NONE);
+    TRACE_GL(glGenFramebuffers, TRACE_NONE);
+    TRACE_GL(glDeleteFramebuffers, TRACE_INVALIDATE);
+    TRACE_GL(glBindFramebuffer, TRACE_BINDING);
+    TRACE_GL(glFramebufferTexture2D, TRACE_NONE);
+    TRACE_GL(glCheckFramebufferStatus, TRACE_NONE);
+    TRACE_GL(glDrawBuffers, TRACE_NONE);
+    TRACE_GL(glMultiDrawElementsIndirect, TRACE_NONE);
+#ifdef _WIN32
+    TRACE_GL(glActiveTexture, TRACE_NONE);
+#endif
 
-    static Mat4 translate(const Vec3& v) {
-        Mat4 res;
-        res.m[3][0] = v.x;
-        res.m[3][1] = v.y;
-        res.m[3][2] = v.z;
-        return res;
+    const char* dumpPath = std::getenv("CGHW3_GL_TRACE_DUMP");
+    if (dumpPath && *dumpPath) {
+        glTrace.dump.open(dumpPath);
+        glTrace.dump << "frame,entry,calls,redundant,cpu_us,max_us\n";
     }
+}
+#endif
 
-    static Mat4 scale(const Vec3& v) {
-        Mat4 res;
-        res.m[0][0] = v.x;
-        res.m[1][1] = v.y;
-        res.m[2][2] = v.z;
-        return res;
+// ---------------------------------------------------------------------------------------------------------
+// Sphere Geometry Generation
+// ---------------------------------------------------------------------------------------------------------
+// The sphere is a shared-vertex grid: one vertex per pole and `slices` vertices per inner ring
+// (the seam wraps around, no texture coordinates need it split). Triangles reference it through
+// an index buffer that is reordered for the post-transform vertex cache. Meshes too large for the
+// sequential cache optimizer are not kept on the CPU at all: SphereBuffers streams them straight
+// into mapped GL buffers in grid order.
+const unsigned int PRIMITIVE_RESTART_INDEX = 0xFFFFFFFFu;
+const int VERTEX_CACHE_SIZE = 16; // Conservative post-transform cache size to optimize for
+const int SPHERE_OPTIMIZE_MAX_VERTICES = 512 * 512;
+
+std::vector<float> sphereVertices;            // 6 floats per vertex (3 pos + 3 normal)
+std::vector<unsigned int> sphereIndices;      // GL_TRIANGLES, cache optimized
+std::vector<unsigned int> sphereStripIndices; // GL_TRIANGLE_STRIP, one strip per stack, split by restart
+int sphereVertexCount = 0;
+int sphereIndexCount = 0;
+int sphereStripIndexCount = 0;
+float sphereACMRBefore = 0.0f; // Average cache miss ratio (transformed vertices per triangle)
+float sphereACMRAfter = 0.0f;
+float sphereRadius = 1.0f;
+int sphereGridStacks = 0;
+int sphereGridSlices = 0;
+bool sphereStreamed = false; // GPU only: the CPU arrays above are empty
+
+// Split [0, count) into contiguous chunks, one per hardware thread; small jobs run inline
+void parallelFor(int count, int minChunk, const std::function<void(int, int)>& body) {
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int chunks = std::min(threads, (count + minChunk - 1) / minChunk);
+    if (chunks <= 1) {
+        body(0, count);
+        return;
     }
+    std::vector<std::thread> workers;
+    for (int c = 1; c < chunks; ++c) {
+        workers.emplace_back(body, (int)((long long)count * c / chunks), (int)((long long)count * (c + 1) / chunks));
+    }
+    body(0, count / chunks);
+    for (std::thread& worker : workers) worker.join();
+}
 
-    static Mat4 rotate(float angleRadians, const Vec3& axis) {
-        Mat4 res;
-        Vec3 a = axis.normalize();
-        float c = std::cos(angleRadians);
-        float s = std::sin(angleRadians);
-        float t = 1.0f - c;
-
-        res.m[0][0] = c + a.x * a.x * t;
-        res.m[0][1] = a.x * a.y * t + a.z * s;
-        res.m[0][2] = a.x * a.z * t - a.y * s;
-
-        res.m[1][0] = a.y * a.x * t - a.z * s;
-        res.m[1][1] = c + a.y * a.y * t;
-        res.m[1][2] = a.y * a.z * t + a.x * s;
+// Trig tables and exact output sizes for a stacks x slices grid. Every write function fills a
+// range of rings (vertices) or stacks (indices) at its final offset, so ranges can be generated
+// concurrently into preallocated or mapped memory.
+struct SphereGrid {
+    int stacks;
+    int slices;
+    std::vector<float> ringSin, ringCos;       // phi = i / stacks * PI, for i in [0, stacks]
+    std::vector<float> segmentSin, segmentCos; // theta = j / slices * 2 PI, for j in [0, slices)
+
+    SphereGrid(int stacks, int slices) : stacks(stacks), slices(slices) {
+        ringSin.resize(stacks + 1);
+        ringCos.resize(stacks + 1);
+        for (int i = 0; i <= stacks; ++i) {
+            float phi = (float)i / stacks * PI;
+            ringSin[i] = std::sin(phi);
+            ringCos[i] = std::cos(phi);
+        }
+        segmentSin.resize(slices);
+        segmentCos.resize(slices);
+        for (int j = 0; j < slices; ++j) {
+            float theta = (float)j / slices * 2.0f * PI;
+            segmentSin[j] = std::sin(theta);
+            segmentCos[j] = std::cos(theta);
+        }
+    }
 
-        res.m[2][0] = a.z * a.x * t + a.y * s;
-        res.m[2][1] = a.z * a.y * t - a.x * s;
-        res.m[2][2] = c + a.z * a.z * t;
+    int vertexCount() const { return (stacks - 1) * slices + 2; }
+    int indexCount() const { return 6 * (stacks - 1) * slices; }
+    int stripIndexCount() const { return stacks * (2 * slices + 3); }
 
-        return res;
+    // Vertex index of (ring i, segment j): ring 0 and ring `stacks` are the single pole vertices
+    unsigned int vertexIndex(int i, int j) const {
+        if (i == 0) return 0;
+        if (i == stacks) return 1 + (stacks - 1) * slices;
+        return 1 + (i - 1) * slices + (j % slices);
     }
 
-    static Mat4 perspective(float fovRadians, float aspect, float nearPlane, float farPlane) {
-        Mat4 res;
-        // Zero out
-        for(int i=0; i<4; ++i) for(int j=0; j<4; ++j) res.m[i][j] = 0.0f;
+    // Unit direction of grid point (i, j)
+    Vec3 direction(int i, int j) const {
+        j = (i == 0 || i == stacks) ? 0 : j % slices;
+        return Vec3(ringSin[i] * segmentCos[j], ringCos[i], ringSin[i] * segmentSin[j]);
+    }
 
-        float tanHalfFovy = std::tan(fovRadians / 2.0f);
+    // First vertex of ring i; ring stacks + 1 is one past the last vertex
+    int ringFirstVertex(int i) const { return i == 0 ? 0 : i > stacks ? vertexCount() : 1 + (i - 1) * slices; }
+
+    // Position and normal of rings [firstRing, endRing), `stride` floats apart; `out` holds
+    // vertex `baseVertex` onwards
+    void writeVertices(float* out, int stride, float radius, int firstRing, int endRing, int baseVertex = 0) const {
+        for (int i = firstRing; i < endRing; ++i) {
+            int segments = (i == 0 || i == stacks) ? 1 : slices;
+            for (int j = 0; j < segments; ++j) {
+                Vec3 n = direction(i, j);
+                float* v = out + (size_t)(vertexIndex(i, j) - baseVertex) * stride;
+                v[0] = radius * n.x; v[1] = radius * n.y; v[2] = radius * n.z;
+                v[3] = n.x; v[4] = n.y; v[5] = n.z;
+            }
+        }
+    }
 
-        res.m[0][0] = 1.0f / (aspect * tanHalfFovy);
-        res.m[1][1] = 1.0f / tanHalfFovy;
-        res.m[2][2] = -(farPlane + nearPlane) / (farPlane - nearPlane);
-        res.m[2][3] = -1.0f;
-        res.m[3][2] = -(2.0f * farPlane * nearPlane) / (farPlane - nearPlane);
-        
-        return res;
+    // Triangle list of stacks [firstStack, endStack): (i,j) (i+1,j) (i+1,j+1) and (i,j) (i+1,j+1)
+    // (i,j+1), dropping the triangle of each quad that collapses at a pole
+    void writeIndices(unsigned int* out, int firstStack, int endStack) const {
+        out += firstStack == 0 ? 0 : 3 * slices + (size_t)(firstStack - 1) * 6 * slices;
+        for (int i = firstStack; i < endStack; ++i) {
+            for (int j = 0; j < slices; ++j) {
+                unsigned int a = vertexIndex(i, j), b = vertexIndex(i + 1, j);
+                unsigned int c = vertexIndex(i + 1, j + 1), d = vertexIndex(i, j + 1);
+                if (i != stacks - 1) { *out++ = a; *out++ = b; *out++ = c; }
+                if (i != 0) { *out++ = a; *out++ = c; *out++ = d; }
+            }
+        }
     }
 
-    static Mat4 lookAt(const Vec3& eye, const Vec3& center, const Vec3& up) {
-        Vec3 f = (center - eye).normalize();
-        Vec3 s = f.cross(up).normalize();
-        Vec3 u = s.cross(f);
+    // One strip per stack, each terminated by PRIMITIVE_RESTART_INDEX
+    void writeStripIndices(unsigned int* out, int firstStack, int endStack) const {
+        out += (size_t)firstStack * (2 * slices + 3);
+        for (int i = firstStack; i < endStack; ++i) {
+            for (int j = 0; j <= slices; ++j) {
+                *out++ = vertexIndex(i, j);
+                *out++ = vertexIndex(i + 1, j);
+            }
+            *out++ = PRIMITIVE_RESTART_INDEX;
+        }
+    }
+};
 
-        Mat4 res;
-        res.m[0][0] = s.x; res.m[1][0] = s.y; res.m[2][0] = s.z;
-        res.m[0][1] = u.x; res.m[1][1] = u.y; res.m[2][1] = u.z;
-        res.m[0][2] = -f.x; res.m[1][2] = -f.y; res.m[2][2] = -f.z;
-        res.m[3][0] = -s.dot(eye);
-        res.m[3][1] = -u.dot(eye);
-        res.m[3][2] = f.dot(eye);
-        
-        return res;
+// Simulate a FIFO post-transform cache, as found on most GPUs
+float computeACMR(const std::vector<unsigned int>& indices, int vertexCount, int cacheSize) {
+    if (indices.empty()) return 0.0f;
+    std::vector<int> timestamp(vertexCount, -cacheSize - 1);
+    int time = 0;
+    int misses = 0;
+    for (unsigned int v : indices) {
+        if (time - timestamp[v] > cacheSize) {
+            timestamp[v] = time++;
+            ++misses;
+        }
     }
+    return (float)misses / (indices.size() / 3);
+}
 
-    Mat4 operator*(const Mat4& other) const {
-        Mat4 res;
-        for (int col = 0; col < 4; ++col) {
-            for (int row = 0; row < 4; ++row) {
-                res.m[col][row] = 0.0f;
-                for (int k = 0; k < 4; ++k) {
-                    res.m[col][row] += m[k][row] * other.m[col][k];
+// Tipsify (Sander, Nehab & Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw", 2007): fan around the vertex that is still in cache and has the most triangles left,
+// falling back to recently used vertices when a fan dead-ends. Linear in the triangle count.
+std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices, int vertexCount, int cacheSize) {
+    int triangleCount = (int)indices.size() / 3;
+
+    // Vertex -> triangle adjacency
+    std::vector<int> live(vertexCount, 0);
+    for (unsigned int v : indices) live[v]++;
+    std::vector<int> offset(vertexCount + 1, 0);
+    for (int v = 0; v < vertexCount; ++v) offset[v + 1] = offset[v] + live[v];
+    std::vector<int> adjacency(indices.size());
+    std::vector<int> fill(offset.begin(), offset.end() - 1);
+    for (int t = 0; t < triangleCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<int> deadEnd;
+    std::vector<int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    int time = cacheSize + 1;
+    int cursor = 1;
+    int fanning = vertexCount > 0 ? 0 : -1;
+
+    while (fanning >= 0) {
+        candidates.clear();
+        for (int a = offset[fanning]; a < offset[fanning + 1]; ++a) {
+            int t = adjacency[a];
+            if (emitted[t]) continue;
+            for (int k = 0; k < 3; ++k) {
+                int v = (int)indices[t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
                 }
             }
+            emitted[t] = true;
         }
-        return res;
+
+        // Next fanning vertex: the candidate still in cache after emitting its remaining triangles
+        int best = -1;
+        int bestPriority = -1;
+        for (int v : candidates) {
+            if (live[v] <= 0) continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        // Dead end: most recently used vertex with triangles left, else the next one in order
+        while (best < 0 && !deadEnd.empty()) {
+            int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) best = v;
+        }
+        while (best < 0 && cursor < vertexCount) {
+            if (live[cursor] > 0) best = cursor;
+            ++cursor;
+        }
+        fanning = best;
     }
-    
-    const float* value_ptr() const {
-        return &m[0][0];
+    return result;
+}
+
+// Renumber vertices in order of first use, so vertex fetch walks the buffer sequentially
+void optimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices, std::vector<unsigned int>& stripIndices, int floatsPerVertex) {
+    int vertexCount = (int)(vertices.size() / floatsPerVertex);
+    std::vector<unsigned int> remap(vertexCount, PRIMITIVE_RESTART_INDEX);
+    std::vector<float> reordered(vertices.size());
+    unsigned int next = 0;
+    for (unsigned int& v : indices) {
+        if (remap[v] == PRIMITIVE_RESTART_INDEX) {
+            std::copy_n(&vertices[v * floatsPerVertex], floatsPerVertex, &reordered[next * floatsPerVertex]);
+            remap[v] = next++;
+        }
+        v = remap[v];
+    }
+    for (unsigned int& v : stripIndices) {
+        if (v != PRIMITIVE_RESTART_INDEX) v = remap[v];
     }
+    vertices.swap(reordered);
+}
+
+struct SphereMesh {
+    std::vector<float> vertices;            // floatsPerVertex floats per vertex
+    std::vector<unsigned int> indices;      // GL_TRIANGLES, cache optimized
+    std::vector<unsigned int> stripIndices; // GL_TRIANGLE_STRIP, split by PRIMITIVE_RESTART_INDEX
+    int floatsPerVertex = 6;
+    int vertexCount = 0;
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
 };
 
-// ---------------------------------------------------------------------------------------------------------
-// Sphere Geometry Generation
-// ---------------------------------------------------------------------------------------------------------
-std::vector<float> sphereVertices;
-int sphereVertexCount = 0;
+// With morphTargets, each vertex also carries where it sits on the sphere of half the tessellation
+// (3 pos + 3 normal + 3 morph pos + 3 morph normal), for geomorphing between LOD levels. Vertices
+// shared with the coarse level map to themselves; the others map to the midpoint of the coarse
+// edge or quad diagonal they split. Requires even stacks and slices.
+SphereMesh buildSphereMesh(float radius, int stacks, int slices, bool morphTargets) {
+    SphereMesh mesh;
+    mesh.floatsPerVertex = morphTargets ? 12 : 6;
+    SphereGrid grid(stacks, slices);
+
+    mesh.vertices.resize((size_t)grid.vertexCount() * mesh.floatsPerVertex);
+    mesh.indices.resize(grid.indexCount());
+    mesh.stripIndices.resize(grid.stripIndexCount());
+    const int rowsPerTask = 16;
+    parallelFor(stacks + 1, rowsPerTask, [&](int first, int end) {
+        grid.writeVertices(mesh.vertices.data(), mesh.floatsPerVertex, radius, first, end);
+    });
+    parallelFor(stacks, rowsPerTask, [&](int first, int end) {
+        grid.writeIndices(mesh.indices.data(), first, end);
+        grid.writeStripIndices(mesh.stripIndices.data(), first, end);
+    });
+
+    if (morphTargets) {
+        parallelFor(stacks + 1, rowsPerTask, [&](int first, int end) {
+            for (int i = first; i < end; ++i) {
+                int segments = (i == 0 || i == stacks) ? 1 : slices;
+                for (int j = 0; j < segments; ++j) {
+                    Vec3 m = grid.direction(i, j);
+                    if (i % 2 == 1 && j % 2 == 1) m = (grid.direction(i - 1, j - 1) + grid.direction(i + 1, j + 1)) * 0.5f;
+                    else if (i % 2 == 1) m = (grid.direction(i - 1, j) + grid.direction(i + 1, j)) * 0.5f;
+                    else if (j % 2 == 1) m = (grid.direction(i, j - 1) + grid.direction(i, j + 1)) * 0.5f;
+                    float* v = &mesh.vertices[(size_t)grid.vertexIndex(i, j) * 12 + 6];
+                    v[0] = radius * m.x; v[1] = radius * m.y; v[2] = radius * m.z;
+                    v[3] = m.x; v[4] = m.y; v[5] = m.z;
+                }
+            }
+        });
+    }
 
-void generateSphere(float radius, int stacks, int slices) {
-    sphereVertices.clear();
-    
-    for (int i = 0; i < stacks; ++i) {
-        float phi1 = (float)i / stacks * PI;
-        float phi2 = (float)(i + 1) / stacks * PI;
+    mesh.vertexCount = (int)(mesh.vertices.size() / mesh.floatsPerVertex);
+    mesh.acmrBefore = computeACMR(mesh.indices, mesh.vertexCount, VERTEX_CACHE_SIZE);
+    mesh.indices = optimizeVertexCache(mesh.indices, mesh.vertexCount, VERTEX_CACHE_SIZE);
+    optimizeVertexFetch(mesh.vertices, mesh.indices, mesh.stripIndices, mesh.floatsPerVertex);
+    mesh.acmrAfter = computeACMR(mesh.indices, mesh.vertexCount, VERTEX_CACHE_SIZE);
+    return mesh;
+}
 
-        for (int j = 0; j < slices; ++j) {
-            float theta1 = (float)j / slices * 2.0f * PI;
-            float theta2 = (float)(j + 1) / slices * 2.0f * PI;
+void generateSphere(float radius, int stacks, int slices) {
+    sphereRadius = radius;
+    sphereGridStacks = stacks;
+    sphereGridSlices = slices;
+
+    SphereGrid grid(stacks, slices);
+    sphereStreamed = grid.vertexCount() > SPHERE_OPTIMIZE_MAX_VERTICES;
+    if (sphereStreamed) {
+        std::vector<float>().swap(sphereVertices);
+        std::vector<unsigned int>().swap(sphereIndices);
+        std::vector<unsigned int>().swap(sphereStripIndices);
+        sphereVertexCount = grid.vertexCount();
+        sphereIndexCount = grid.indexCount();
+        sphereStripIndexCount = grid.stripIndexCount();
+        sphereACMRBefore = sphereACMRAfter = 0.0f;
+        return;
+    }
 
-            // 4 vertices for a quad (2 triangles)
-            // We'll generate 2 triangles per quad directly
-            
-            // Triangle 1: (phi1, theta1), (phi2, theta1), (phi2, theta2)
-            // Triangle 2: (phi1, theta1), (phi2, theta2), (phi1, theta2)
+    SphereMesh mesh = buildSphereMesh(radius, stacks, slices, false);
+    sphereVertices.swap(mesh.vertices);
+    sphereIndices.swap(mesh.indices);
+    sphereStripIndices.swap(mesh.stripIndices);
 
-            float phis[4] = {phi1, phi2, phi2, phi1};
-            float thetas[4] = {theta1, theta1, theta2, theta2};
+    sphereVertexCount = mesh.vertexCount; // 6 floats per vertex (3 pos + 3 normal)
+    sphereACMRBefore = mesh.acmrBefore;
+    sphereACMRAfter = mesh.acmrAfter;
+    sphereIndexCount = (int)sphereIndices.size();
+    sphereStripIndexCount = (int)sphereStripIndices.size();
+}
 
-            // Vertices for 2 triangles (6 vertices total)
-            int indices[6] = {0, 1, 2, 0, 2, 3};
+// ---------------------------------------------------------------------------------------------------------
+// Vertex Quantization
+// ---------------------------------------------------------------------------------------------------------
+// Compact encodings of the (position, normal) vertices above. Positions become 16-bit snorm
+// relative to the mesh bounds and are dequantized in the vertex shader with positionScale and
+// positionOffset. Normals are either octahedrally mapped to two 16-bit snorm values, or dropped
+// and rebuilt from the position, which only holds for spheres centred in their bounds. The enum
+// values double as the shader's normalEncoding.
+enum VertexFormat { VERTEX_FLOAT, VERTEX_OCTAHEDRAL, VERTEX_POSITION_ONLY, VERTEX_FORMAT_COUNT };
+const char* vertexFormatNames[VERTEX_FORMAT_COUNT] = { "Float (24 B)", "SNORM16 + Octahedral Normal (12 B)", "SNORM16, Normal From Position (8 B)" };
+const int vertexFormatStrides[VERTEX_FORMAT_COUNT] = { 24, 12, 8 }; // Positions padded to 4 shorts
+
+struct Quantization {
+    Vec3 scale = Vec3(1.0f, 1.0f, 1.0f);
+    Vec3 offset;
+};
 
-            for (int k = 0; k < 6; ++k) {
-                int idx = indices[k];
-                float phi = phis[idx];
-                float theta = thetas[idx];
+// Map the bounding box of `count` vertices (`stride` floats apart) onto [-1, 1]^3
+Quantization computeQuantization(const float* vertices, int count, int stride) {
+    Quantization q;
+    if (count == 0) return q;
+    Vec3 lo(vertices[0], vertices[1], vertices[2]), hi = lo;
+    for (int v = 1; v < count; ++v) {
+        const float* p = vertices + (size_t)v * stride;
+        lo = Vec3(std::min(lo.x, p[0]), std::min(lo.y, p[1]), std::min(lo.z, p[2]));
+        hi = Vec3(std::max(hi.x, p[0]), std::max(hi.y, p[1]), std::max(hi.z, p[2]));
+    }
+    q.offset = (lo + hi) * 0.5f;
+    q.scale = (hi - lo) * 0.5f;
+    q.scale = Vec3(std::max(q.scale.x, 1e-6f), std::max(q.scale.y, 1e-6f), std::max(q.scale.z, 1e-6f));
+    return q;
+}
 
-                float x = radius * std::sin(phi) * std::cos(theta);
-                float y = radius * std::cos(phi);
-                float z = radius * std::sin(phi) * std::sin(theta);
+int16_t toSnorm16(float value) {
+    return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
 
-                // Position
-                sphereVertices.push_back(x);
-                sphereVertices.push_back(y);
-                sphereVertices.push_back(z);
+// Octahedral normal encoding (Meyer et al. 2010): project onto the octahedron |x|+|y|+|z| = 1,
+// folding the lower hemisphere over the diagonals
+void encodeOctahedral(const Vec3& n, int16_t out[2]) {
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    float u = n.x / l1, v = n.y / l1;
+    if (n.z < 0.0f) {
+        float foldedU = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float foldedV = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = foldedU;
+        v = foldedV;
+    }
+    out[0] = toSnorm16(u);
+    out[1] = toSnorm16(v);
+}
 
-                // Normal (normalized position for a sphere at origin)
-                Vec3 n(x, y, z);
-                n = n.normalize();
-                sphereVertices.push_back(n.x);
-                sphereVertices.push_back(n.y);
-                sphereVertices.push_back(n.z);
-            }
+// Pack `count` float vertices (6 floats each) into `format`, vertexFormatStrides[format] bytes apart
+void packVertices(const float* in, int count, int format, const Quantization& q, unsigned char* out) {
+    int stride = vertexFormatStrides[format];
+    for (int v = 0; v < count; ++v, in += 6, out += stride) {
+        if (format == VERTEX_FLOAT) {
+            std::memcpy(out, in, 6 * sizeof(float));
+            continue;
         }
+        int16_t* packed = (int16_t*)out;
+        packed[0] = toSnorm16((in[0] - q.offset.x) / q.scale.x);
+        packed[1] = toSnorm16((in[1] - q.offset.y) / q.scale.y);
+        packed[2] = toSnorm16((in[2] - q.offset.z) / q.scale.z);
+        packed[3] = 0;
+        if (format == VERTEX_OCTAHEDRAL) encodeOctahedral(Vec3(in[3], in[4], in[5]), packed + 4);
     }
-    sphereVertexCount = (int)(sphereVertices.size() / 6); // 6 floats per vertex (3 pos + 3 normal)
 }
 
 // ---------------------------------------------------------------------------------------------------------
@@ -326,18 +966,51 @@ const char* vertexShaderSource = R"(
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec3 aMorphPos;    // Position on the next coarser LOD level
+layout (location = 3) in vec3 aMorphNormal;
 
 out vec3 FragPos;
 out vec3 Normal;
+out vec3 Color;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+layout (std140) uniform Material {
+    vec3 objectColor;
+    float shininess;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix; // transpose(inverse(mat3(model))), computed once per draw on the CPU
+uniform float morph;       // 0 = coarse LOD shape, 1 = this level; meshes without morph targets use 1
+uniform vec3 positionScale;  // Dequantization of snorm positions; (1, 1, 1) and 0 for float meshes
+uniform vec3 positionOffset;
+uniform int normalEncoding;  // VertexFormat: 0 float, 1 octahedral in aNormal.xy, 2 from position
+
+vec3 decodeNormal(vec3 encoded, vec3 quantized)
+{
+    if (normalEncoding == 2) return normalize(positionScale * quantized);
+    if (normalEncoding == 1) {
+        vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+        float t = max(-n.z, 0.0);
+        n.x += n.x >= 0.0 ? -t : t;
+        n.y += n.y >= 0.0 ? -t : t;
+        return normalize(n);
+    }
+    return encoded;
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    vec3 position = positionOffset + positionScale * aPos;
+    vec3 normal = decodeNormal(aNormal, aPos);
+    FragPos = vec3(model * vec4(mix(aMorphPos, position, morph), 1.0));
+    Normal = normalMatrix * mix(aMorphNormal, normal, morph);
+    Color = objectColor;
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
@@ -349,12 +1022,23 @@ out vec4 FragColor;
 
 in vec3 Normal;
 in vec3 FragPos;
+in vec3 Color;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
-uniform vec3 lightPos; 
-uniform vec3 viewPos; 
-uniform vec3 lightColor;
-uniform vec3 objectColor;
-uniform float shininess;
+layout (std140) uniform Light {
+    vec3 lightPos;
+    vec3 lightColor;
+};
+
+layout (std140) uniform Material {
+    vec3 objectColor;
+    float shininess;
+};
 
 void main()
 {
@@ -375,11 +1059,242 @@ void main()
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     vec3 specular = specularStrength * spec * lightColor;  
         
-    vec3 result = (ambient + diffuse + specular) * objectColor;
+    vec3 result = (ambient + diffuse + specular) * Color;
     FragColor = vec4(result, 1.0);
 } 
 )";
 
+// Per-instance model matrix and colour come from vertex attributes (divisor 1). Instance transforms
+// are restricted to rotation, translation and uniform scale, so mat3(model) is a valid normal
+// matrix up to scale, which the fragment shader normalizes away.
+const char* instancedVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 4) in mat4 aInstanceModel; // Locations 4-7, one column each
+layout (location = 8) in vec3 aInstanceColor;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+uniform vec3 positionScale;  // Dequantization of snorm positions; (1, 1, 1) and 0 for float meshes
+uniform vec3 positionOffset;
+uniform int normalEncoding;  // VertexFormat: 0 float, 1 octahedral in aNormal.xy, 2 from position
+
+vec3 decodeNormal(vec3 encoded, vec3 quantized)
+{
+    if (normalEncoding == 2) return normalize(positionScale * quantized);
+    if (normalEncoding == 1) {
+        vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+        float t = max(-n.z, 0.0);
+        n.x += n.x >= 0.0 ? -t : t;
+        n.y += n.y >= 0.0 ? -t : t;
+        return normalize(n);
+    }
+    return encoded;
+}
+
+void main()
+{
+    FragPos = vec3(aInstanceModel * vec4(positionOffset + positionScale * aPos, 1.0));
+    Normal = mat3(aInstanceModel) * decodeNormal(aNormal, aPos);
+    Color = aInstanceColor;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
+)";
+
+// Multi-draw indirect: per-draw transform and colour come from a storage buffer indexed by the
+// draw's position in the command list, so every object may use a different mesh
+const char* multiDrawVertexShaderSource = R"(
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+struct DrawData {
+    mat4 model; // Rotation, translation and uniform scale only, as for instances
+    vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer DrawBlock {
+    DrawData draws[];
+};
+
+void main()
+{
+    DrawData draw = draws[gl_DrawIDARB];
+    FragPos = vec3(draw.model * vec4(aPos, 1.0));
+    Normal = mat3(draw.model) * aNormal;
+    Color = draw.color.rgb;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
+)";
+
+// Deferred shading: either vertex shader above paired with this one fills the G-buffer instead
+// of lighting. World position is not stored, the lighting pass rebuilds it from depth.
+const char* gbufferFragmentShaderSource = R"(
+#version 330 core
+layout (location = 0) out vec4 gNormal; // xyz world normal, w shininess
+layout (location = 1) out vec4 gAlbedo;
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec3 Color;
+
+layout (std140) uniform Material {
+    vec3 objectColor;
+    float shininess;
+};
+
+void main()
+{
+    gNormal = vec4(normalize(Normal), shininess);
+    gAlbedo = vec4(Color, 1.0);
+}
+)";
+
+// Full-screen triangle from gl_VertexID, no vertex buffer
+const char* fullscreenVertexShaderSource = R"(
+#version 330 core
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Ambient term plus the scene's main light, exactly as fragmentShaderSource computes them. Pixels
+// the geometry pass did not touch keep the colour the default framebuffer was cleared to.
+const char* deferredAmbientFragmentShaderSource = R"(
+#version 330 core
+out vec4 FragColor;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+layout (std140) uniform Light {
+    vec3 lightPos;
+    vec3 lightColor;
+};
+
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth == 1.0) discard;
+    vec4 clip = inverseViewProjection * vec4(vec3(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth) * 2.0 - 1.0, 1.0);
+    vec3 FragPos = clip.xyz / clip.w;
+    vec4 normalShininess = texelFetch(gNormal, texel, 0);
+    vec3 Color = texelFetch(gAlbedo, texel, 0).rgb;
+
+    vec3 ambient = 0.1 * lightColor;
+    vec3 norm = normalShininess.xyz;
+    vec3 lightDir = normalize(lightPos - FragPos);
+    vec3 diffuse = max(dot(norm, lightDir), 0.0) * lightColor;
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    vec3 specular = 0.5 * pow(max(dot(viewDir, reflectDir), 0.0), normalShininess.w) * lightColor;
+
+    FragColor = vec4((ambient + diffuse + specular) * Color, 1.0);
+}
+)";
+
+// One instance of the light volume sphere per point light (divisor 1), scaled to its radius
+const char* lightVolumeVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aLight; // xyz position, w radius
+layout (location = 2) in vec3 aLightColor;
+
+flat out vec4 Light;
+flat out vec3 LightColor;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+void main()
+{
+    Light = aLight;
+    LightColor = aLightColor;
+    gl_Position = projection * view * vec4(aLight.xyz + aPos * aLight.w, 1.0);
+}
+)";
+
+// Adds one point light to the pixels its volume covers. The window makes the light fall to zero
+// at the volume surface, so the cut-off is invisible.
+const char* lightVolumeFragmentShaderSource = R"(
+#version 330 core
+out vec4 FragColor;
+
+flat in vec4 Light;
+flat in vec3 LightColor;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth == 1.0) discard;
+    vec4 clip = inverseViewProjection * vec4(vec3(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth) * 2.0 - 1.0, 1.0);
+    vec3 FragPos = clip.xyz / clip.w;
+    vec3 toLight = Light.xyz - FragPos;
+    float distance = length(toLight);
+    if (distance >= Light.w) discard;
+    vec4 normalShininess = texelFetch(gNormal, texel, 0);
+    vec3 Color = texelFetch(gAlbedo, texel, 0).rgb;
+
+    vec3 norm = normalShininess.xyz;
+    vec3 lightDir = toLight / distance;
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = 0.5 * pow(max(dot(viewDir, reflectDir), 0.0), normalShininess.w);
+    float window = clamp(1.0 - pow(distance / Light.w, 4.0), 0.0, 1.0);
+
+    FragColor = vec4((diff + spec) * window * window * LightColor * Color, 1.0);
+}
+)";
+
 void checkCompileErrors(unsigned int shader, std::string type)
 {
     int success;
@@ -423,6 +1338,7 @@ unsigned int createShaderProgram(const char* vShaderCode, const char* fShaderCod
     unsigned int ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
+    if (glProgramParameteri) glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
     
@@ -433,109 +1349,1984 @@ unsigned int createShaderProgram(const char* vShaderCode, const char* fShaderCod
     return ID;
 }
 
-// Forward declarations
-void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow *window);
+// ---------------------------------------------------------------------------------------------------------
+// Program Binary Cache
+// ---------------------------------------------------------------------------------------------------------
+// Linked programs are saved with glGetProgramBinary under a hash of both shader sources and the
+// driver's vendor/renderer/version strings, so a driver update never sees another driver's
+// binaries. Loading goes through glProgramBinary; a missing, corrupt or rejected binary falls
+// back to compiling from source and the entry is rewritten. The directory comes from
+// CGHW3_SHADER_CACHE (empty disables the cache) and defaults to ./shader_cache.
+const char PROGRAM_CACHE_MAGIC[4] = { 'C', 'G', 'P', 'B' };
+
+struct ProgramBinaryCache {
+    bool enabled = false;
+    std::filesystem::path directory;
+    std::string driver; // Vendor, renderer and version, folded into every key
+    int hits = 0;
+    int misses = 0;
+    bool lastHit = false;
+    double lastLoadMs = 0.0;
+
+    // Call once the context is current and the GL functions are loaded
+    void init() {
+        const char* override = std::getenv("CGHW3_SHADER_CACHE");
+        directory = override ? override : "shader_cache";
+        GLint formats = 0;
+        if (glGetProgramBinary && glProgramBinary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        enabled = formats > 0 && !directory.empty();
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            const GLubyte* value = glGetString(name);
+            driver += value ? (const char*)value : "";
+            driver += '\n';
+        }
+    }
 
-// Settings
-const unsigned int SCR_WIDTH = 1280;
-const unsigned int SCR_HEIGHT = 720;
+    // 64-bit FNV-1a over the driver string and both sources
+    static uint64_t hash(const std::string& driver, const char* vShaderCode, const char* fShaderCode) {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const char* text, size_t length) {
+            for (size_t i = 0; i < length; ++i) {
+                h ^= (unsigned char)text[i];
+                h *= 1099511628211ull;
+            }
+        };
+        mix(driver.c_str(), driver.size() + 1);
+        mix(vShaderCode, std::strlen(vShaderCode) + 1);
+        mix(fShaderCode, std::strlen(fShaderCode) + 1);
+        return h;
+    }
 
-int main()
-{
-    // glfw: initialize and configure
-    // ------------------------------
-    if (!glfwInit())
-        return -1;
+    std::filesystem::path entryPath(uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory / name;
+    }
 
-    // Use Compatibility Profile for legacy OpenGL support (glVertex)
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+    // Returns 0 when there is no usable binary for `key`
+    GLuint tryLoad(uint64_t key) const {
+        std::ifstream file(entryPath(key), std::ios::binary);
+        if (!file) return 0;
+        char magic[4];
+        uint64_t storedKey = 0;
+        uint32_t format = 0, length = 0;
+        file.read(magic, sizeof(magic));
+        file.read((char*)&storedKey, sizeof(storedKey));
+        file.read((char*)&format, sizeof(format));
+        file.read((char*)&length, sizeof(length));
+        if (!file || std::memcmp(magic, PROGRAM_CACHE_MAGIC, sizeof(magic)) != 0 || storedKey != key || length == 0) return 0;
+        std::vector<char> binary(length);
+        if (!file.read(binary.data(), length)) return 0;
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, format, binary.data(), (GLsizei)length);
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
 
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
+    void store(uint64_t key, GLuint program) const {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        // Write to a temporary name and rename, so a concurrent reader never sees a partial entry
+        std::filesystem::path path = entryPath(key), temporary = path;
+        temporary += ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                std::cout << "WARNING::PROGRAM_CACHE: cannot write " << temporary.string() << std::endl;
+                return;
+            }
+            uint32_t storedFormat = format, storedLength = (uint32_t)length;
+            file.write(PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+            file.write((const char*)&key, sizeof(key));
+            file.write((const char*)&storedFormat, sizeof(storedFormat));
+            file.write((const char*)&storedLength, sizeof(storedLength));
+            file.write(binary.data(), length);
+        }
+        std::filesystem::rename(temporary, path, error);
+    }
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "CG HW3: Phong Shading & VBO", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+    // Linked program for the given sources, from the cache when possible
+    GLuint load(const char* vShaderCode, const char* fShaderCode) {
+        auto start = std::chrono::steady_clock::now();
+        GLuint program = 0;
+        uint64_t key = 0;
+        if (enabled) {
+            key = hash(driver, vShaderCode, fShaderCode);
+            program = tryLoad(key);
+        }
+        lastHit = program != 0;
+        if (!lastHit) {
+            program = createShaderProgram(vShaderCode, fShaderCode);
+            GLint success = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            if (enabled && success) store(key, program);
+        }
+        ++(lastHit ? hits : misses);
+        lastLoadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return program;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSwapInterval(1); // Enable vsync
+};
 
-    // Setup Dear ImGui context
-    // ------------------------
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO();
-    io.IniFilename = nullptr; // Disable saving .ini file
-    ImGui::StyleColorsDark();
+ProgramBinaryCache programCache;
 
-    // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330");
+// ---------------------------------------------------------------------------------------------------------
+// Shader Program Abstraction & GL State Cache
+// ---------------------------------------------------------------------------------------------------------
+// Tracks the bound program and VAO so redundant binds never reach the driver. Anything that binds
+// behind its back must call invalidate(); the ImGui OpenGL3 backend restores what it changes.
+struct GLStateCache {
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    unsigned int issuedCalls = 0;
+    unsigned int skippedCalls = 0;
+
+    void useProgram(GLuint id) {
+        if (id == program) { ++skippedCalls; return; }
+        glUseProgram(id);
+        program = id;
+        ++issuedCalls;
+    }
 
-    // Load OpenGL functions
-    loadOpenGLFunctions();
-    std::cout << "OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
+    void bindVertexArray(GLuint id) {
+        if (id == vertexArray) { ++skippedCalls; return; }
+        glBindVertexArray(id);
+        vertexArray = id;
+        ++issuedCalls;
+    }
 
-    // Math Library Verification
-    // -------------------------
-    std::cout << "Verifying Math Library..." << std::endl;
-    Vec3 v1(1.0f, 0.0f, 0.0f);
-    Vec3 v2(0.0f, 1.0f, 0.0f);
-    Vec3 v3 = v1.cross(v2);
-    std::cout << "Cross Product (1,0,0)x(0,1,0) = (" << v3.x << ", " << v3.y << ", " << v3.z << ")" << std::endl;
-    
+    void invalidate() {
+        program = GL_INVALID_INDEX;
+        vertexArray = GL_INVALID_INDEX;
+    }
+};
+
+GLStateCache glState;
+
+template <typename T> struct UniformTraits;
+template <> struct UniformTraits<int> { static const GLenum type = GL_INT; static const int components = 1; };
+template <> struct UniformTraits<float> { static const GLenum type = GL_FLOAT; static const int components = 1; };
+template <> struct UniformTraits<Vec3> { static const GLenum type = GL_FLOAT_VEC3; static const int components = 3; };
+template <> struct UniformTraits<Mat3> { static const GLenum type = GL_FLOAT_MAT3; static const int components = 9; };
+template <> struct UniformTraits<Mat4> { static const GLenum type = GL_FLOAT_MAT4; static const int components = 16; };
+
+// A sampler uniform holds the texture unit it reads from
+struct Sampler2D { int unit; };
+template <> struct UniformTraits<Sampler2D> { static const GLenum type = GL_SAMPLER_2D; static const int components = 1; };
+
+// Typed handle into a ShaderProgram's reflected uniform table; invalid handles are ignored on set
+template <typename T>
+struct UniformHandle {
+    int index = -1;
+    bool valid() const { return index >= 0; }
+};
+
+class ShaderProgram {
+public:
+    struct Uniform {
+        std::string name;
+        GLint location;
+        GLenum type;
+        GLint size;
+        float value[16]; // Last value sent, for redundant-set elimination
+        bool hasValue;
+    };
+
+    GLuint id = 0;
+    std::vector<Uniform> uniforms;
+
+    // Compile, link and reflect the default-block uniforms once
+    void create(const char* vShaderCode, const char* fShaderCode) {
+        id = programCache.load(vShaderCode, fShaderCode);
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; ++i) {
+            Uniform uniform = {};
+            glGetActiveUniform(id, (GLuint)i, (GLsizei)name.size(), NULL, &uniform.size, &uniform.type, name.data());
+            uniform.name = name.data();
+            uniform.location = glGetUniformLocation(id, name.data());
+            if (uniform.location < 0) continue; // Uniform block member
+            uniforms.push_back(uniform);
+        }
+    }
+
+    void destroy() {
+        glDeleteProgram(id);
+        id = 0;
+        uniforms.clear();
+    }
+
+    template <typename T>
+    UniformHandle<T> uniform(const char* name) const {
+        UniformHandle<T> handle;
+        for (size_t i = 0; i < uniforms.size(); ++i) {
+            if (uniforms[i].name != name) continue;
+            if (uniforms[i].type != UniformTraits<T>::type) {
+                std::cout << "ERROR::SHADER_UNIFORM_TYPE_MISMATCH: " << name << std::endl;
+                return handle;
+            }
+            handle.index = (int)i;
+            return handle;
+        }
+        std::cout << "WARNING::SHADER_UNIFORM_NOT_ACTIVE: " << name << std::endl;
+        return handle;
+    }
+
+    // Bind a named uniform block to a UBO binding point; a no-op if the block was optimized out
+    void bindBlock(const char* name, GLuint binding) const {
+        GLuint index = glGetUniformBlockIndex(id, name);
+        if (index != GL_INVALID_INDEX) glUniformBlockBinding(id, index, binding);
+    }
+
+    void use() const { glState.useProgram(id); }
+
+    void set(UniformHandle<int> handle, int value) {
+        float bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        if (!changed(handle.index, &bits, 1)) return;
+        glUniform1i(uniforms[handle.index].location, value);
+    }
+
+    void set(UniformHandle<Sampler2D> handle, Sampler2D value) {
+        float bits;
+        std::memcpy(&bits, &value.unit, sizeof(bits));
+        if (!changed(handle.index, &bits, 1)) return;
+        glUniform1i(uniforms[handle.index].location, value.unit);
+    }
+
+    void set(UniformHandle<float> handle, float value) {
+        if (!changed(handle.index, &value, 1)) return;
+        glUniform1f(uniforms[handle.index].location, value);
+    }
+
+    void set(UniformHandle<Vec3> handle, const Vec3& value) {
+        const float v[3] = { value.x, value.y, value.z };
+        if (!changed(handle.index, v, 3)) return;
+        glUniform3fv(uniforms[handle.index].location, 1, v);
+    }
+
+    void set(UniformHandle<Mat3> handle, const Mat3& value) {
+        if (!changed(handle.index, value.value_ptr(), 9)) return;
+        glUniformMatrix3fv(uniforms[handle.index].location, 1, GL_FALSE, value.value_ptr());
+    }
+
+    void set(UniformHandle<Mat4> handle, const Mat4& value) {
+        if (!changed(handle.index, value.value_ptr(), 16)) return;
+        glUniformMatrix4fv(uniforms[handle.index].location, 1, GL_FALSE, value.value_ptr());
+    }
+
+private:
+    // Uniform values are program state, so the program must be current before glUniform*
+    bool changed(int index, const float* value, int components) {
+        if (index < 0) return false;
+        Uniform& uniform = uniforms[index];
+        if (uniform.hasValue && std::memcmp(uniform.value, value, components * sizeof(float)) == 0) {
+            ++glState.skippedCalls;
+            return false;
+        }
+        std::memcpy(uniform.value, value, components * sizeof(float));
+        uniform.hasValue = true;
+        use();
+        ++glState.issuedCalls;
+        return true;
+    }
+};
+
+// Uniform buffer holding one std140 block; uploads only when the contents change
+template <typename Block>
+struct UniformBuffer {
+    GLuint id = 0;
+    GLuint binding = 0;
+    Block data;
+    bool hasData = false;
+
+    void create(GLuint bindingPoint) {
+        binding = bindingPoint;
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+        bind();
+    }
+
+    // Re-attach to the binding point after something else (e.g. a streamed block) took it over
+    void bind() { glBindBufferBase(GL_UNIFORM_BUFFER, binding, id); }
+
+    void update(const Block& block) {
+        if (hasData && std::memcmp(&data, &block, sizeof(Block)) == 0) {
+            ++glState.skippedCalls;
+            return;
+        }
+        data = block;
+        hasData = true;
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &data);
+        ++glState.issuedCalls;
+    }
+
+    void destroy() { glDeleteBuffers(1, &id); }
+};
+
+// std140 mirrors of the shader blocks (vec3 is aligned to 16 bytes)
+enum UniformBinding { BINDING_CAMERA = 0, BINDING_LIGHT = 1, BINDING_MATERIAL = 2 };
+
+struct CameraBlock {
+    float view[16];
+    float projection[16];
+    float viewPos[3];
+    float pad0;
+};
+
+struct LightBlock {
+    float lightPos[3];
+    float pad0;
+    float lightColor[3];
+    float pad1;
+};
+
+struct MaterialBlock {
+    float objectColor[3];
+    float shininess;
+};
+
+// ---------------------------------------------------------------------------------------------------------
+// Sphere Level of Detail
+// ---------------------------------------------------------------------------------------------------------
+// A chain of spheres, each with twice the stacks/slices of the previous one, sharing one VBO/IBO.
+// Buffers are sized for the whole chain up front; a level's geometry is only generated and
+// uploaded the first time it is selected. Indices are stored already offset by the level's first
+// vertex, so no base-vertex draw is needed.
+const int SPHERE_LOD_LEVELS = 6;
+const int SPHERE_LOD_BASE_SEGMENTS = 6; // Stacks and slices of level 0; level i uses 6 * 2^i
+
+struct SphereLODLevel {
+    int segments;
+    bool generated;
+    int firstVertex;
+    int firstIndex;
+    int indexCount;
+};
+
+struct SphereLODChain {
+    float radius = 1.0f;
+    GLuint vao = 0, vbo = 0, ibo = 0;
+    SphereLODLevel levels[SPHERE_LOD_LEVELS];
+
+    void create(float sphereRadius) {
+        radius = sphereRadius;
+        int vertexTotal = 0, indexTotal = 0;
+        for (int level = 0; level < SPHERE_LOD_LEVELS; ++level) {
+            int n = SPHERE_LOD_BASE_SEGMENTS << level;
+            levels[level] = { n, false, vertexTotal, indexTotal, 6 * n * (n - 1) };
+            vertexTotal += (n - 1) * n + 2;
+            indexTotal += levels[level].indexCount;
+        }
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ibo);
+        glState.bindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexTotal * 12 * sizeof(float), NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexTotal * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+        for (GLuint attribute = 0; attribute < 4; ++attribute) {
+            glVertexAttribPointer(attribute, 3, GL_FLOAT, GL_FALSE, 12 * sizeof(float), (void*)(attribute * 3 * sizeof(float)));
+            glEnableVertexAttribArray(attribute);
+        }
+        glState.bindVertexArray(0);
+    }
+
+    void ensure(int level) {
+        SphereLODLevel& lod = levels[level];
+        if (lod.generated) return;
+        SphereMesh mesh = buildSphereMesh(radius, lod.segments, lod.segments, true);
+        for (unsigned int& index : mesh.indices) index += lod.firstVertex;
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)lod.firstVertex * 12 * sizeof(float), mesh.vertices.size() * sizeof(float), mesh.vertices.data());
+        glState.bindVertexArray(vao);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)lod.firstIndex * sizeof(unsigned int), mesh.indices.size() * sizeof(unsigned int), mesh.indices.data());
+        lod.generated = true;
+    }
+
+    // Pick the coarsest level whose equator edges are at most targetEdgePixels long. morph is how far
+    // the required tessellation has moved from the next coarser level towards this one.
+    int select(float projectedRadiusPixels, float targetEdgePixels, float& morph) const {
+        float required = 2.0f * PI * projectedRadiusPixels / targetEdgePixels;
+        int level = 0;
+        while (level < SPHERE_LOD_LEVELS - 1 && levels[level].segments < required) ++level;
+
+        morph = 1.0f;
+        if (level > 0) {
+            float coarse = (float)levels[level - 1].segments;
+            morph = std::min(std::max((required - coarse) / (levels[level].segments - coarse), 0.0f), 1.0f);
+        }
+        return level;
+    }
+
+    void draw(int level) {
+        ensure(level);
+        glState.bindVertexArray(vao);
+        glDrawElements(GL_TRIANGLES, levels[level].indexCount, GL_UNSIGNED_INT, (void*)(levels[level].firstIndex * sizeof(unsigned int)));
+    }
+
+    void destroy() {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ibo);
+    }
+};
+
+// Radius in pixels of a sphere's silhouette at `distance` from the eye
+float projectedRadiusPixels(float radius, float distance, float fovY, float viewportHeight) {
+    float tangent = distance > radius ? radius / std::sqrt(distance * distance - radius * radius) : 1e6f;
+    return tangent / std::tan(fovY * 0.5f) * viewportHeight * 0.5f;
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// Instanced Rendering
+// ---------------------------------------------------------------------------------------------------------
+// Per-instance data lives in one vertex buffer read with attribute divisor 1. Scene updates mark
+// the instances they touch; upload() merges the dirty ranges and sends only those, reallocating
+// the whole buffer only when it has to grow.
+const GLuint INSTANCE_MODEL_LOCATION = 4; // mat4 takes locations 4-7
+const GLuint INSTANCE_COLOR_LOCATION = 8;
+const size_t INSTANCE_MERGE_GAP = 64;     // Clean instances worth re-sending to save an upload call
+
+struct InstanceData {
+    float model[16]; // Column-major, as Mat4::value_ptr
+    float color[3];
+    float pad;
+};
+
+struct InstanceBuffer {
+    GLuint vbo = 0;
+    std::vector<InstanceData> instances;
+    size_t capacity = 0;
+    std::vector<std::pair<size_t, size_t>> dirty; // [begin, end)
+    size_t uploadedBytes = 0;                     // Last upload() only
+    int uploadCalls = 0;
+
+    void create() { glGenBuffers(1, &vbo); }
+
+    void resize(size_t count) {
+        instances.resize(count);
+        dirty.assign(1, std::make_pair((size_t)0, count));
+    }
+
+    void markDirty(size_t first, size_t count) {
+        if (count > 0) dirty.push_back(std::make_pair(first, first + count));
+    }
+
+    // Attach the instance attributes to the currently bound VAO
+    void setupAttributes() const {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        for (GLuint column = 0; column < 4; ++column) {
+            GLuint location = INSTANCE_MODEL_LOCATION + column;
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(column * 4 * sizeof(float)));
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, color));
+        glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+        glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+    }
+
+    void upload() {
+        uploadedBytes = 0;
+        uploadCalls = 0;
+        if (dirty.empty()) return;
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+        if (instances.size() > capacity) {
+            capacity = instances.size();
+            glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), instances.data(), GL_DYNAMIC_DRAW);
+            uploadedBytes = capacity * sizeof(InstanceData);
+            uploadCalls = 1;
+            dirty.clear();
+            return;
+        }
+
+        std::sort(dirty.begin(), dirty.end());
+        size_t begin = dirty[0].first, end = dirty[0].second;
+        for (size_t i = 1; i <= dirty.size(); ++i) {
+            if (i < dirty.size() && dirty[i].first <= end + INSTANCE_MERGE_GAP) {
+                end = std::max(end, dirty[i].second);
+                continue;
+            }
+            end = std::min(end, instances.size());
+            if (begin < end) {
+                glBufferSubData(GL_ARRAY_BUFFER, begin * sizeof(InstanceData), (end - begin) * sizeof(InstanceData), &instances[begin]);
+                uploadedBytes += (end - begin) * sizeof(InstanceData);
+                ++uploadCalls;
+            }
+            if (i < dirty.size()) {
+                begin = dirty[i].first;
+                end = dirty[i].second;
+            }
+        }
+        dirty.clear();
+    }
+
+    void destroy() { glDeleteBuffers(1, &vbo); }
+};
+
+// Lay instances out on a cube grid spanning [-1, 1]^3, coloured by position
+void layoutInstanceGrid(InstanceBuffer& buffer, int count) {
+    buffer.resize(count);
+    int side = 1;
+    while (side * side * side < count) ++side;
+    float spacing = 2.0f / side;
+    float scale = spacing * 0.35f;
+
+    for (int i = 0; i < count; ++i) {
+        int x = i % side, y = (i / side) % side, z = i / (side * side);
+        Vec3 position(-1.0f + (x + 0.5f) * spacing, -1.0f + (y + 0.5f) * spacing, -1.0f + (z + 0.5f) * spacing);
+        Mat4 model = Mat4::translate(position) * Mat4::scale(Vec3(scale, scale, scale));
+
+        InstanceData& instance = buffer.instances[i];
+        std::memcpy(instance.model, model.value_ptr(), sizeof(instance.model));
+        instance.color[0] = 0.3f + 0.7f * (x + 0.5f) / side;
+        instance.color[1] = 0.3f + 0.7f * (y + 0.5f) / side;
+        instance.color[2] = 0.3f + 0.7f * (z + 0.5f) / side;
+        instance.pad = 0.0f;
+    }
+}
+
+// Spin `count` instances starting at `first` (wrapping around), keeping position and scale
+void animateInstances(InstanceBuffer& buffer, size_t first, size_t count, float time) {
+    size_t total = buffer.instances.size();
+    if (total == 0) return;
+    count = std::min(count, total);
+    for (size_t k = 0; k < count; ++k) {
+        size_t i = (first + k) % total;
+        InstanceData& instance = buffer.instances[i];
+        Vec3 position(instance.model[12], instance.model[13], instance.model[14]);
+        float scale = Vec3(instance.model[0], instance.model[1], instance.model[2]).length();
+        Mat4 model = Mat4::translate(position) * Mat4::rotate(time + i * 0.01f, Vec3(0.5f, 1.0f, 0.0f)) * Mat4::scale(Vec3(scale, scale, scale));
+        std::memcpy(instance.model, model.value_ptr(), sizeof(instance.model));
+    }
+    size_t head = std::min(count, total - first);
+    buffer.markDirty(first, head);
+    buffer.markDirty(0, count - head);
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// Scene & Frustum Culling
+// ---------------------------------------------------------------------------------------------------------
+// Many sphere objects scattered around the camera, each bounded by its own sphere. A BVH over the
+// bounds is built once (median split on the widest axis) and refit bottom-up when objects move.
+// Objects are stored in BVH order as x/y/z/radius arrays, so every node covers a contiguous range:
+// a node fully inside the frustum emits its range untested, and leaves that straddle a plane test
+// their spheres in SIMD batches. The visible list becomes the instance buffer for one draw.
+const int BVH_LEAF_SIZE = 8;
+const float SCENE_EXTENT = 50.0f; // Objects fill [-extent, extent]^3
+
+struct BVHNode {
+    Vec3 lo, hi;
+    int first, count; // Objects covered by the whole subtree
+    int left;         // Children are left and left + 1; -1 for leaves
+};
+
+struct Scene {
+    // Per object, in BVH order
+    std::vector<float> x, y, z, radius;
+    std::vector<Vec3> basePosition;
+    std::vector<Vec3> color;
+    std::vector<float> phase;
+    std::vector<BVHNode> nodes;
+
+    std::vector<unsigned int> visible;
+    int nodesVisited = 0;
+
+    int size() const { return (int)x.size(); }
+
+    void generate(int count, unsigned int seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> position(-SCENE_EXTENT, SCENE_EXTENT), size(0.2f, 0.6f), unit(0.0f, 1.0f);
+        basePosition.resize(count);
+        color.resize(count);
+        phase.resize(count);
+        radius.resize(count);
+        for (int i = 0; i < count; ++i) {
+            basePosition[i] = Vec3(position(rng), position(rng), position(rng));
+            radius[i] = size(rng);
+            color[i] = Vec3(0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng));
+            phase[i] = unit(rng) * 2.0f * PI;
+        }
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        for (int i = 0; i < count; ++i) {
+            x[i] = basePosition[i].x;
+            y[i] = basePosition[i].y;
+            z[i] = basePosition[i].z;
+        }
+        build();
+    }
+
+    // Top-down build that also permutes the objects into leaf order
+    void build() {
+        int count = size();
+        std::vector<int> order(count);
+        for (int i = 0; i < count; ++i) order[i] = i;
+        nodes.clear();
+        if (count == 0) return;
+        nodes.reserve(2 * (count / BVH_LEAF_SIZE + 1));
+        nodes.push_back(BVHNode{ Vec3(), Vec3(), 0, count, -1 });
+
+        std::vector<int> pending(1, 0);
+        while (!pending.empty()) {
+            int index = pending.back();
+            pending.pop_back();
+            BVHNode node = nodes[index];
+            if (node.count <= BVH_LEAF_SIZE) continue;
+
+            Vec3 lo(x[order[node.first]], y[order[node.first]], z[order[node.first]]), hi = lo;
+            for (int k = node.first; k < node.first + node.count; ++k) {
+                int o = order[k];
+                lo = Vec3(std::min(lo.x, x[o]), std::min(lo.y, y[o]), std::min(lo.z, z[o]));
+                hi = Vec3(std::max(hi.x, x[o]), std::max(hi.y, y[o]), std::max(hi.z, z[o]));
+            }
+            Vec3 extent = hi - lo;
+            const std::vector<float>& axis = (extent.x >= extent.y && extent.x >= extent.z) ? x : (extent.y >= extent.z ? y : z);
+            int half = node.count / 2;
+            std::nth_element(order.begin() + node.first, order.begin() + node.first + half, order.begin() + node.first + node.count,
+                             [&axis](int a, int b) { return axis[a] < axis[b]; });
+
+            int left = (int)nodes.size();
+            nodes[index].left = left;
+            nodes.push_back(BVHNode{ Vec3(), Vec3(), node.first, half, -1 });
+            nodes.push_back(BVHNode{ Vec3(), Vec3(), node.first + half, node.count - half, -1 });
+            pending.push_back(left);
+            pending.push_back(left + 1);
+        }
+
+        auto permute = [&order](auto& values) {
+            std::remove_reference_t<decltype(values)> sorted(values.size());
+            for (size_t k = 0; k < order.size(); ++k) sorted[k] = values[order[k]];
+            values.swap(sorted);
+        };
+        permute(x); permute(y); permute(z); permute(radius);
+        permute(basePosition); permute(color); permute(phase);
+        refit();
+    }
+
+    // Children always come after their parent, so a reverse sweep sees children first
+    void refit() {
+        for (int n = (int)nodes.size() - 1; n >= 0; --n) {
+            BVHNode& node = nodes[n];
+            if (node.left >= 0) {
+                const BVHNode& a = nodes[node.left];
+                const BVHNode& b = nodes[node.left + 1];
+                node.lo = Vec3(std::min(a.lo.x, b.lo.x), std::min(a.lo.y, b.lo.y), std::min(a.lo.z, b.lo.z));
+                node.hi = Vec3(std::max(a.hi.x, b.hi.x), std::max(a.hi.y, b.hi.y), std::max(a.hi.z, b.hi.z));
+                continue;
+            }
+            int o = node.first;
+            node.lo = Vec3(x[o] - radius[o], y[o] - radius[o], z[o] - radius[o]);
+            node.hi = Vec3(x[o] + radius[o], y[o] + radius[o], z[o] + radius[o]);
+            for (o = node.first + 1; o < node.first + node.count; ++o) {
+                node.lo = Vec3(std::min(node.lo.x, x[o] - radius[o]), std::min(node.lo.y, y[o] - radius[o]), std::min(node.lo.z, z[o] - radius[o]));
+                node.hi = Vec3(std::max(node.hi.x, x[o] + radius[o]), std::max(node.hi.y, y[o] + radius[o]), std::max(node.hi.z, z[o] + radius[o]));
+            }
+        }
+    }
+
+    // Bob every object vertically around its base position; the tree topology is kept
+    void animate(float time) {
+        for (int i = 0; i < size(); ++i) {
+            x[i] = basePosition[i].x;
+            y[i] = basePosition[i].y + 2.0f * std::sin(time + phase[i]);
+            z[i] = basePosition[i].z;
+        }
+        refit();
+    }
+
+    void cull(const Frustum& frustum, bool useBVH, bool useSIMD) {
+        visible.resize(size());
+        size_t written = 0;
+        nodesVisited = 0;
+        if (!useBVH || nodes.empty()) {
+            written = cullSpheres(frustum, x.data(), y.data(), z.data(), radius.data(), size(), 0, visible.data(), useSIMD);
+            visible.resize(written);
+            return;
+        }
+
+        std::pair<int, unsigned int> stack[64]; // (node, planes still to test); depth is ~log2(n / leaf)
+        int top = 0;
+        stack[top++] = std::make_pair(0, 0x3Fu);
+        while (top > 0) {
+            int index = stack[top - 1].first;
+            unsigned int mask = stack[--top].second;
+            const BVHNode& node = nodes[index];
+            ++nodesVisited;
+            if (!frustum.classifyBox(node.lo, node.hi, mask)) continue;
+            if (mask == 0) {
+                for (int o = node.first; o < node.first + node.count; ++o) visible[written++] = (unsigned int)o;
+            } else if (node.left < 0) {
+                written += cullSpheres(frustum, &x[node.first], &y[node.first], &z[node.first], &radius[node.first],
+                                       node.count, node.first, &visible[written], useSIMD);
+            } else {
+                stack[top++] = std::make_pair(node.left + 1, mask);
+                stack[top++] = std::make_pair(node.left, mask);
+            }
+        }
+        visible.resize(written);
+    }
+
+    // Write the visible objects into the instance buffer
+    void fillInstances(InstanceBuffer& buffer) const {
+        buffer.resize(visible.size());
+        for (size_t k = 0; k < visible.size(); ++k) {
+            unsigned int o = visible[k];
+            Mat4 model = Mat4::translate(Vec3(x[o], y[o], z[o])) * Mat4::scale(Vec3(radius[o], radius[o], radius[o]));
+            InstanceData& instance = buffer.instances[k];
+            std::memcpy(instance.model, model.value_ptr(), sizeof(instance.model));
+            std::memcpy(instance.color, &color[o], sizeof(instance.color));
+            instance.pad = 0.0f;
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------
+// Streaming Buffers
+// ---------------------------------------------------------------------------------------------------------
+// A ring of STREAM_FRAMES regions in one buffer for data rewritten every frame. Each frame
+// sub-allocates from its own region and fences it when submitted; the region is only reused once
+// that fence has signalled, so writes never race the GPU and no orphaning is needed. With buffer
+// storage (GL 4.4 / ARB_buffer_storage) the whole ring stays persistently mapped (coherent); without
+// it the current region is mapped unsynchronized at beginFrame and unmapped by flush before drawing.
+// Regions are sized in multiples of the largest UBO/SSBO offset alignment, so an allocation aligned
+// within the buffer stays aligned in every region.
+const int STREAM_FRAMES = 3;
+const GLuint64 STREAM_WAIT_TIMEOUT = 1000000000; // 1 s per wait call, in nanoseconds
+
+struct StreamAllocation {
+    void* data = NULL; // NULL when the frame region is full
+    GLintptr offset = 0;
+};
+
+struct StreamBuffer {
+    GLuint id = 0;
+    GLsizeiptr frameSize = 0;
+    GLsizeiptr regionAlignment = 256; // Every region starts at a multiple of this
+    bool storageSupported = false;    // GL 4.4 or ARB_buffer_storage
+    bool persistent = false;
+    unsigned char* mapped = NULL; // Whole ring when persistent, else the current region
+    GLsync fences[STREAM_FRAMES] = {};
+    int frame = 0;
+    GLsizeiptr head = 0;          // Bytes used in the current region
+    GLsizeiptr usedBytes = 0;     // Last completed frame
+    unsigned int stalls = 0;      // Frames that had to wait for the GPU
+
+    // alignment: the largest offset alignment any allocation needs (UBO, SSBO), 256 at least
+    void create(GLsizeiptr bytesPerFrame, bool bufferStorage, GLsizeiptr alignment) {
+        storageSupported = bufferStorage;
+        regionAlignment = std::max<GLsizeiptr>(alignment, 256);
+        frameSize = (bytesPerFrame + regionAlignment - 1) / regionAlignment * regionAlignment;
+        persistent = storageSupported && glBufferStorage != NULL;
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_ARRAY_BUFFER, id);
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, frameSize * STREAM_FRAMES, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, frameSize * STREAM_FRAMES, flags);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, frameSize * STREAM_FRAMES, NULL, GL_DYNAMIC_DRAW);
+        }
+    }
+
+    // Grow so a frame can hold `bytes`; waits for the GPU, so call it only when the size changes
+    void reserve(GLsizeiptr bytes) {
+        if (bytes <= frameSize) return;
+        destroy();
+        create(bytes + bytes / 2, storageSupported, regionAlignment);
+    }
+
+    // Wait until the GPU is done with this frame's region, then start allocating from it
+    void beginFrame() {
+        GLsync& fence = fences[frame];
+        if (fence) {
+            GLenum result = glClientWaitSync(fence, 0, 0);
+            if (result == GL_TIMEOUT_EXPIRED) {
+                ++stalls;
+                do {
+                    result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_WAIT_TIMEOUT);
+                } while (result == GL_TIMEOUT_EXPIRED);
+            }
+            if (result == GL_WAIT_FAILED) std::cout << "ERROR::STREAM_BUFFER: fence wait failed" << std::endl;
+            glDeleteSync(fence);
+            fence = NULL;
+        }
+        head = 0;
+        if (!persistent) {
+            glBindBuffer(GL_ARRAY_BUFFER, id);
+            GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+            mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, frame * frameSize, frameSize, access);
+        }
+    }
+
+    // Sub-allocate `bytes` with the offset from the buffer start aligned to `alignment`
+    StreamAllocation allocate(GLsizeiptr bytes, GLsizeiptr alignment = 4) {
+        StreamAllocation allocation;
+        GLsizeiptr base = frame * frameSize;
+        GLsizeiptr start = (base + head + alignment - 1) / alignment * alignment - base;
+        if (!mapped || start + bytes > frameSize) return allocation;
+        head = start + bytes;
+        allocation.offset = frame * frameSize + start;
+        allocation.data = mapped + (persistent ? allocation.offset : start);
+        return allocation;
+    }
+
+    // Make this frame's writes visible to the GL; call before drawing from the allocations
+    void flush() {
+        if (persistent || !mapped) return;
+        glBindBuffer(GL_ARRAY_BUFFER, id);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        mapped = NULL;
+    }
+
+    // Fence everything submitted from this frame's region and move to the next one
+    void endFrame() {
+        flush();
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        usedBytes = head;
+        frame = (frame + 1) % STREAM_FRAMES;
+    }
+
+    void destroy() {
+        for (GLsync& fence : fences) {
+            if (!fence) continue;
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_WAIT_TIMEOUT);
+            glDeleteSync(fence);
+            fence = NULL;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, id);
+        if (mapped) glUnmapBuffer(GL_ARRAY_BUFFER);
+        mapped = NULL;
+        glDeleteBuffers(1, &id);
+        frame = 0;
+        head = 0;
+    }
+};
+
+// The current sphere displaced along its normals by moving waves, with normals recomputed from
+// the deformed faces. Vertices, indices and the material block are all streamed every frame.
+struct DeformableSphere {
+    GLuint vao = 0;
+    std::vector<Vec3> positions; // Scratch: displaced positions, the mapping is write-only
+    std::vector<Vec3> normals;   // Scratch for face normal accumulation
+
+    void create() { glGenVertexArrays(1, &vao); }
+
+    // Returns false if the frame region could not hold the mesh
+    bool draw(StreamBuffer& stream, float time, float amplitude, const MaterialBlock& material, GLint uniformAlignment) {
+        if (sphereStreamed) return false; // Deforms the CPU copy, which GPU-only meshes lack
+        GLsizeiptr vertexBytes = (GLsizeiptr)sphereVertexCount * 6 * sizeof(float);
+        GLsizeiptr indexBytes = (GLsizeiptr)sphereIndexCount * sizeof(unsigned int);
+        stream.reserve(vertexBytes + indexBytes + sizeof(MaterialBlock) + 2 * uniformAlignment);
+
+        stream.beginFrame();
+        StreamAllocation vertices = stream.allocate(vertexBytes, 6 * sizeof(float));
+        StreamAllocation indices = stream.allocate(indexBytes, sizeof(unsigned int));
+        StreamAllocation block = stream.allocate(sizeof(MaterialBlock), uniformAlignment);
+        if (!vertices.data || !indices.data || !block.data) {
+            stream.endFrame();
+            return false;
+        }
+
+        // Displace and build normals in the scratch arrays (the mapping is write-only, possibly
+        // write-combined), then write every vertex to it exactly once
+        positions.resize(sphereVertexCount);
+        for (int v = 0; v < sphereVertexCount; ++v) {
+            const float* in = &sphereVertices[v * 6];
+            Vec3 normal(in[3], in[4], in[5]);
+            float wave = std::sin(5.0f * normal.x + 2.0f * time) * std::sin(4.0f * normal.y + 3.0f * time) * std::sin(3.0f * normal.z + time);
+            positions[v] = Vec3(in[0], in[1], in[2]) * (1.0f + amplitude * wave);
+        }
+        normals.assign(sphereVertexCount, Vec3(0.0f, 0.0f, 0.0f));
+        for (int i = 0; i + 2 < sphereIndexCount; i += 3) {
+            unsigned int a = sphereIndices[i], b = sphereIndices[i + 1], c = sphereIndices[i + 2];
+            Vec3 face = (positions[c] - positions[a]).cross(positions[b] - positions[a]); // Area weighted, outward for the sphere winding
+            normals[a] = normals[a] + face;
+            normals[b] = normals[b] + face;
+            normals[c] = normals[c] + face;
+        }
+        float* out = (float*)vertices.data;
+        for (int v = 0; v < sphereVertexCount; ++v) {
+            Vec3 normal = normals[v].normalize();
+            const float vertex[6] = { positions[v].x, positions[v].y, positions[v].z, normal.x, normal.y, normal.z };
+            std::memcpy(&out[v * 6], vertex, sizeof(vertex));
+        }
+        std::memcpy(indices.data, sphereIndices.data(), indexBytes);
+        std::memcpy(block.data, &material, sizeof(MaterialBlock));
+        stream.flush();
+
+        // Point the attributes at this frame's allocation
+        glState.bindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, stream.id);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)vertices.offset);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(vertices.offset + 3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream.id);
+        glBindBufferRange(GL_UNIFORM_BUFFER, BINDING_MATERIAL, stream.id, block.offset, sizeof(MaterialBlock));
+
+        glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, (void*)indices.offset);
+        stream.endFrame();
+        return true;
+    }
+
+    void destroy() { glDeleteVertexArrays(1, &vao); }
+};
+
+// ---------------------------------------------------------------------------------------------------------
+// Multi-Draw Indirect
+// ---------------------------------------------------------------------------------------------------------
+// Every mesh lives in one vertex/index arena (6 floats per vertex, indices relative to the mesh),
+// so any mix of meshes is drawn without rebinding. A draw list is one DrawElementsIndirectCommand
+// per object plus its DrawData in a shader storage buffer, which the vertex shader indexes with
+// gl_DrawIDARB. Both are written straight into the stream ring and the whole list is submitted
+// with one glMultiDrawElementsIndirect. Needs GL 4.3 and ARB_shader_draw_parameters (Mesa's
+// llvmpipe has both); without them the scene stays on the instanced path.
+const GLuint DRAW_DATA_BINDING = 0; // Matches the shader's DrawBlock binding
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// std430 mirror of the shader's DrawData
+struct DrawData {
+    float model[16];
+    float color[4];
+};
+
+struct ArenaMesh {
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+};
+
+struct MeshArena {
+    GLuint vao = 0, vbo = 0, ibo = 0;
+    std::vector<ArenaMesh> meshes;
+    std::vector<float> vertices; // Everything added so far, uploaded as a whole by upload()
+    std::vector<unsigned int> indices;
+
+    // Append a mesh, keeping position and normal only; returns its index in `meshes`
+    int add(const SphereMesh& mesh) {
+        meshes.push_back({ (GLuint)indices.size(), (GLuint)mesh.indices.size(), (GLint)(vertices.size() / 6) });
+        for (size_t v = 0; v < mesh.vertices.size(); v += mesh.floatsPerVertex) {
+            vertices.insert(vertices.end(), mesh.vertices.begin() + v, mesh.vertices.begin() + v + 6);
+        }
+        indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+        return (int)meshes.size() - 1;
+    }
+
+    void upload() {
+        if (!vao) {
+            glGenVertexArrays(1, &vao);
+            glGenBuffers(1, &vbo);
+            glGenBuffers(1, &ibo);
+            glState.bindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        }
+        glState.bindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    }
+
+    size_t bytes() const { return vertices.size() * sizeof(float) + indices.size() * sizeof(unsigned int); }
+
+    void destroy() {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ibo);
+    }
+};
+
+// Draw the scene's visible objects with one glMultiDrawElementsIndirect, each on the arena mesh of
+// the LOD level `lod` selects for its projected size (lodMeshes maps level to arena mesh).
+// levelCounts receives how many objects used each level. Returns false if nothing was drawn.
+bool drawSceneIndirect(const Scene& scene, const MeshArena& arena, const int* lodMeshes, const SphereLODChain& lod,
+                       StreamBuffer& stream, GLint storageAlignment, const Vec3& eye, float fovY, float viewportHeight,
+                       float targetEdgePixels, int* levelCounts) {
+    std::fill(levelCounts, levelCounts + SPHERE_LOD_LEVELS, 0);
+    size_t count = scene.visible.size();
+    if (count == 0) return false;
+    GLsizeiptr commandBytes = count * sizeof(DrawElementsIndirectCommand);
+    GLsizeiptr drawBytes = count * sizeof(DrawData);
+    stream.reserve(commandBytes + drawBytes + storageAlignment);
+
+    stream.beginFrame();
+    StreamAllocation commandAllocation = stream.allocate(commandBytes, sizeof(GLuint));
+    StreamAllocation drawAllocation = stream.allocate(drawBytes, storageAlignment);
+    if (!commandAllocation.data || !drawAllocation.data) {
+        stream.endFrame();
+        return false;
+    }
+    DrawElementsIndirectCommand* commands = (DrawElementsIndirectCommand*)commandAllocation.data;
+    DrawData* draws = (DrawData*)drawAllocation.data;
+    for (size_t k = 0; k < count; ++k) {
+        unsigned int o = scene.visible[k];
+        Vec3 center(scene.x[o], scene.y[o], scene.z[o]);
+        float r = scene.radius[o], morph;
+        int level = lod.select(projectedRadiusPixels(r, (center - eye).length(), fovY, viewportHeight), targetEdgePixels, morph);
+        ++levelCounts[level];
+        const ArenaMesh& mesh = arena.meshes[lodMeshes[level]];
+        commands[k] = { mesh.indexCount, 1, mesh.firstIndex, mesh.baseVertex, 0 };
+
+        Mat4 model = Mat4::translate(center) * Mat4::scale(Vec3(r, r, r));
+        std::memcpy(draws[k].model, model.value_ptr(), sizeof(draws[k].model));
+        std::memcpy(draws[k].color, &scene.color[o], 3 * sizeof(float));
+        draws[k].color[3] = 1.0f;
+    }
+    stream.flush();
+
+    glState.bindVertexArray(arena.vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream.id);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, stream.id, drawAllocation.offset, drawBytes);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandAllocation.offset, (GLsizei)count, 0);
+    stream.endFrame();
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// Sphere Draw Paths
+// ---------------------------------------------------------------------------------------------------------
+// One VAO per draw path: the indexed and strip paths share the vertex buffer but bind different
+// element buffers, the glDrawArrays path keeps a de-indexed copy for comparison. Every VAO also
+// carries the instance attributes; the non-instanced program does not read them.
+enum DrawMode { DRAW_IMMEDIATE, DRAW_ARRAYS, DRAW_INDEXED, DRAW_STRIP };
+const char* drawModeNames[] = { "Immediate (glBegin)", "VBO (glDrawArrays)", "Indexed (glDrawElements)", "Strip + Restart" };
+
+// Dequantization uniforms of a program using the sphere vertex layout
+struct VertexFormatUniforms {
+    UniformHandle<Vec3> scale;
+    UniformHandle<Vec3> offset;
+    UniformHandle<int> normalEncoding;
+
+    void bind(const ShaderProgram& program) {
+        scale = program.uniform<Vec3>("positionScale");
+        offset = program.uniform<Vec3>("positionOffset");
+        normalEncoding = program.uniform<int>("normalEncoding");
+    }
+
+    void apply(ShaderProgram& program, int format, const Quantization& quantization) {
+        Quantization q = format == VERTEX_FLOAT ? Quantization() : quantization;
+        program.set(scale, q.scale);
+        program.set(offset, q.offset);
+        program.set(normalEncoding, format);
+    }
+};
+
+// A program drawing the sphere vertex layout: the per-object vertex shader (instanced = false) or
+// the instanced one, with either the forward Phong or the G-buffer fragment shader
+struct SurfaceShader {
+    ShaderProgram program;
+    UniformHandle<Mat4> model;
+    UniformHandle<Mat3> normalMatrix;
+    UniformHandle<float> morph;
+    VertexFormatUniforms format;
+
+    void create(const char* vShaderCode, const char* fShaderCode, bool instanced) {
+        program.create(vShaderCode, fShaderCode);
+        program.bindBlock("Camera", BINDING_CAMERA);
+        program.bindBlock("Light", BINDING_LIGHT);
+        program.bindBlock("Material", BINDING_MATERIAL);
+        if (!instanced) {
+            model = program.uniform<Mat4>("model");
+            normalMatrix = program.uniform<Mat3>("normalMatrix");
+            morph = program.uniform<float>("morph");
+        }
+        format.bind(program);
+        format.apply(program, VERTEX_FLOAT, Quantization());
+    }
+
+    void destroy() { program.destroy(); }
+};
+
+struct SphereBuffers {
+    enum { VAO_ARRAYS, VAO_INDEXED, VAO_STRIP, VAO_COUNT };
+    enum { BUFFER_FLAT, BUFFER_VERTICES, BUFFER_INDICES, BUFFER_STRIP_INDICES, BUFFER_COUNT };
+    GLuint VAOs[VAO_COUNT];
+    GLuint buffers[BUFFER_COUNT];
+    int format = VERTEX_FLOAT;
+    Quantization quantization;
+    size_t vertexBytes = 0;
+
+    void create(const InstanceBuffer& instanceBuffer) {
+        glGenVertexArrays(VAO_COUNT, VAOs);
+        glGenBuffers(BUFFER_COUNT, buffers);
+
+        for (GLuint vao : VAOs) {
+            glState.bindVertexArray(vao);
+            instanceBuffer.setupAttributes();
+        }
+        glState.bindVertexArray(VAOs[VAO_INDEXED]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[BUFFER_INDICES]);
+        glState.bindVertexArray(VAOs[VAO_STRIP]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[BUFFER_STRIP_INDICES]);
+        setupVertexAttributes();
+    }
+
+    // Point position (location 0) and normal (location 1) at the vertex buffers in `format`
+    void setupVertexAttributes() {
+        GLsizei stride = vertexFormatStrides[format];
+        const GLuint vertexBuffers[VAO_COUNT] = { buffers[BUFFER_FLAT], buffers[BUFFER_VERTICES], buffers[BUFFER_VERTICES] };
+        for (int i = 0; i < VAO_COUNT; ++i) {
+            glState.bindVertexArray(VAOs[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[i]);
+            if (format == VERTEX_FLOAT) {
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+            } else {
+                glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, (void*)0);
+                glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)(4 * sizeof(int16_t)));
+            }
+            glEnableVertexAttribArray(0);
+            if (format == VERTEX_POSITION_ONLY) glDisableVertexAttribArray(1);
+            else glEnableVertexAttribArray(1);
+        }
+        glState.bindVertexArray(0);
+    }
+
+    void setFormat(int newFormat) {
+        format = newFormat;
+        upload();
+    }
+
+    // Format the shader has to decode for `mode`: immediate mode always submits floats
+    int formatFor(int mode) const {
+        return mode == DRAW_IMMEDIATE && !sphereStreamed ? VERTEX_FLOAT : format;
+    }
+
+    // Upload the current global sphere mesh
+    void upload() {
+        if (sphereStreamed) {
+            uploadStreamed();
+            return;
+        }
+        size_t stride = vertexFormatStrides[format];
+        const unsigned char* vertexData = (const unsigned char*)sphereVertices.data();
+        std::vector<unsigned char> packed;
+        quantization = Quantization();
+        if (format != VERTEX_FLOAT) {
+            quantization = computeQuantization(sphereVertices.data(), sphereVertexCount, 6);
+            packed.resize(sphereVertexCount * stride);
+            packVertices(sphereVertices.data(), sphereVertexCount, format, quantization, packed.data());
+            vertexData = packed.data();
+        }
+        vertexBytes = sphereVertexCount * stride;
+
+        std::vector<unsigned char> flatVertices(sphereIndices.size() * stride);
+        for (size_t i = 0; i < sphereIndices.size(); ++i) {
+            std::memcpy(&flatVertices[i * stride], vertexData + sphereIndices[i] * stride, stride);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_FLAT]);
+        glBufferData(GL_ARRAY_BUFFER, flatVertices.size(), flatVertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_VERTICES]);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+
+        // Element buffer bindings are VAO state, so upload through the owning VAO
+        glState.bindVertexArray(VAOs[VAO_INDEXED]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereIndices.size() * sizeof(unsigned int), sphereIndices.data(), GL_STATIC_DRAW);
+        glState.bindVertexArray(VAOs[VAO_STRIP]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereStripIndices.size() * sizeof(unsigned int), sphereStripIndices.data(), GL_STATIC_DRAW);
+        setupVertexAttributes();
+    }
+
+    // Generate a GPU-only sphere in parallel directly into the mapped buffers. There is no
+    // de-indexed copy, so the arrays and immediate paths fall back to indexed drawing.
+    void uploadStreamed() {
+        SphereGrid grid(sphereGridStacks, sphereGridSlices);
+        const int rowsPerTask = 16;
+        auto fill = [&grid](GLenum target, GLsizeiptr bytes, const std::function<void(void*, int, int)>& write, int rows) {
+            glBufferData(target, bytes, NULL, GL_STATIC_DRAW);
+            void* mapped = glMapBufferRange(target, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (!mapped) {
+                std::cout << "ERROR::SPHERE_BUFFERS: cannot map " << bytes << " bytes" << std::endl;
+                return;
+            }
+            parallelFor(rows, rowsPerTask, [&](int first, int end) { write(mapped, first, end); });
+            if (!glUnmapBuffer(target)) std::cout << "ERROR::SPHERE_BUFFERS: buffer contents lost while mapped" << std::endl;
+        };
+
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_FLAT]);
+        glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_STATIC_DRAW);
+        // The bounds of a sphere are known up front, so quantized rows can be packed as they are made
+        int vertexFormat = format;
+        quantization = Quantization();
+        if (format != VERTEX_FLOAT) quantization.scale = Vec3(sphereRadius, sphereRadius, sphereRadius);
+        Quantization q = quantization;
+        vertexBytes = (size_t)grid.vertexCount() * vertexFormatStrides[format];
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[BUFFER_VERTICES]);
+        fill(GL_ARRAY_BUFFER, (GLsizeiptr)vertexBytes, [&grid, vertexFormat, q](void* out, int first, int end) {
+            if (vertexFormat == VERTEX_FLOAT) {
+                grid.writeVertices((float*)out, 6, sphereRadius, first, end);
+                return;
+            }
+            int firstVertex = grid.ringFirstVertex(first), endVertex = grid.ringFirstVertex(end);
+            std::vector<float> rows((size_t)(endVertex - firstVertex) * 6);
+            grid.writeVertices(rows.data(), 6, sphereRadius, first, end, firstVertex);
+            unsigned char* packed = (unsigned char*)out + (size_t)firstVertex * vertexFormatStrides[vertexFormat];
+            packVertices(rows.data(), endVertex - firstVertex, vertexFormat, q, packed);
+        }, grid.stacks + 1);
+
+        glState.bindVertexArray(VAOs[VAO_INDEXED]);
+        fill(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)grid.indexCount() * sizeof(unsigned int), [&grid](void* out, int first, int end) {
+            grid.writeIndices((unsigned int*)out, first, end);
+        }, grid.stacks);
+        glState.bindVertexArray(VAOs[VAO_STRIP]);
+        fill(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)grid.stripIndexCount() * sizeof(unsigned int), [&grid](void* out, int first, int end) {
+            grid.writeStripIndices((unsigned int*)out, first, end);
+        }, grid.stacks);
+        setupVertexAttributes();
+    }
+
+    // Draw the sphere once, or `instances` times from the instance buffer (not for immediate mode)
+    void draw(int mode, GLsizei instances = 0) {
+        if (sphereStreamed && (mode == DRAW_ARRAYS || mode == DRAW_IMMEDIATE)) mode = DRAW_INDEXED;
+        if (mode == DRAW_ARRAYS) {
+            glState.bindVertexArray(VAOs[VAO_ARRAYS]);
+            if (instances > 0) glDrawArraysInstanced(GL_TRIANGLES, 0, sphereIndexCount, instances);
+            else glDrawArrays(GL_TRIANGLES, 0, sphereIndexCount);
+        } else if (mode == DRAW_INDEXED) {
+            glState.bindVertexArray(VAOs[VAO_INDEXED]);
+            if (instances > 0) glDrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, (void*)0, instances);
+            else glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, (void*)0);
+        } else if (mode == DRAW_STRIP) {
+            glState.bindVertexArray(VAOs[VAO_STRIP]);
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(PRIMITIVE_RESTART_INDEX);
+            if (instances > 0) glDrawElementsInstanced(GL_TRIANGLE_STRIP, sphereStripIndexCount, GL_UNSIGNED_INT, (void*)0, instances);
+            else glDrawElements(GL_TRIANGLE_STRIP, sphereStripIndexCount, GL_UNSIGNED_INT, (void*)0);
+            glDisable(GL_PRIMITIVE_RESTART);
+        } else {
+            // Immediate Mode Rendering
+            glState.bindVertexArray(0); // Unbind VAO
+            
+            glBegin(GL_TRIANGLES);
+            for (int i = 0; i < sphereIndexCount; ++i) {
+                int baseIndex = sphereIndices[i] * 6;
+                // Normal (Location 1)
+                glVertexAttrib3f(1, sphereVertices[baseIndex + 3], sphereVertices[baseIndex + 4], sphereVertices[baseIndex + 5]);
+                // Position (Location 0) - Using glVertex3f to ensure vertex submission
+                glVertex3f(sphereVertices[baseIndex], sphereVertices[baseIndex + 1], sphereVertices[baseIndex + 2]);
+            }
+            glEnd();
+        }
+    }
+
+    void destroy() {
+        glDeleteVertexArrays(VAO_COUNT, VAOs);
+        glDeleteBuffers(BUFFER_COUNT, buffers);
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------
+// Deferred Shading
+// ---------------------------------------------------------------------------------------------------------
+// The geometry pass writes normal + shininess (RGBA16F), albedo (RGBA8) and depth into a G-buffer;
+// world position is rebuilt from depth. The lighting pass draws one full-screen triangle for the
+// ambient term and the main light, then every point light as an instanced sphere volume with
+// additive blending. Only the volume's back faces are rasterized and depth testing is off, so
+// each covered pixel is shaded once per light even with the camera inside a volume: lighting cost
+// follows the screen area lights cover, not geometry x lights.
+const int MAX_POINT_LIGHTS = 1024;
+const int LIGHT_VOLUME_STACKS = 8;
+const int LIGHT_VOLUME_SLICES = 12;
+
+struct GBuffer {
+    enum { TEXTURE_NORMAL, TEXTURE_ALBEDO, TEXTURE_DEPTH, TEXTURE_COUNT };
+    GLuint fbo = 0;
+    GLuint textures[TEXTURE_COUNT];
+    int width = 0;
+    int height = 0;
+
+    void create() {
+        glGenFramebuffers(1, &fbo);
+        glGenTextures(TEXTURE_COUNT, textures);
+    }
+
+    // (Re)allocate the targets when the framebuffer size changes
+    void resize(int w, int h) {
+        if (w == width && h == height) return;
+        width = w;
+        height = h;
+        const GLint internalFormats[TEXTURE_COUNT] = { GL_RGBA16F, GL_RGBA8, GL_DEPTH_COMPONENT24 };
+        const GLenum formats[TEXTURE_COUNT] = { GL_RGBA, GL_RGBA, GL_DEPTH_COMPONENT };
+        const GLenum types[TEXTURE_COUNT] = { GL_HALF_FLOAT, GL_UNSIGNED_BYTE, GL_UNSIGNED_INT };
+        const GLenum attachments[TEXTURE_COUNT] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_DEPTH_ATTACHMENT };
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        for (int i = 0; i < TEXTURE_COUNT; ++i) {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], w, h, 0, formats[i], types[i], NULL);
+            // Read with texelFetch, but without mipmaps the default filter leaves the texture incomplete
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[i], GL_TEXTURE_2D, textures[i], 0);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "ERROR::GBUFFER: framebuffer incomplete at " << w << "x" << h << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    size_t bytes() const { return (size_t)width * height * (8 + 4 + 4); }
+
+    // Texture unit i holds target i
+    void bindTextures() const {
+        for (int i = 0; i < TEXTURE_COUNT; ++i) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void destroy() {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(TEXTURE_COUNT, textures);
+    }
+};
+
+// Per-instance attributes of a light volume
+struct PointLight {
+    float position[3];
+    float radius;
+    float color[3];
+};
+
+// Lights orbit the Y axis; orbit, height and phase are stored for a unit spread and scaled per frame
+struct PointLightOrbit {
+    float orbit;
+    float height;
+    float phase;
+    float speed;
+};
+
+// A lighting-pass program and the G-buffer uniforms it shares with the others
+struct LightingShader {
+    ShaderProgram program;
+    UniformHandle<Mat4> inverseViewProjection;
+
+    void create(const char* vShaderCode, const char* fShaderCode) {
+        program.create(vShaderCode, fShaderCode);
+        program.bindBlock("Camera", BINDING_CAMERA);
+        program.bindBlock("Light", BINDING_LIGHT);
+        inverseViewProjection = program.uniform<Mat4>("inverseViewProjection");
+        program.set(program.uniform<Sampler2D>("gNormal"), Sampler2D{ GBuffer::TEXTURE_NORMAL });
+        program.set(program.uniform<Sampler2D>("gAlbedo"), Sampler2D{ GBuffer::TEXTURE_ALBEDO });
+        program.set(program.uniform<Sampler2D>("gDepth"), Sampler2D{ GBuffer::TEXTURE_DEPTH });
+    }
+
+    void destroy() { program.destroy(); }
+};
+
+struct DeferredRenderer {
+    GBuffer gbuffer;
+    LightingShader ambientShader;
+    LightingShader lightShader;
+    GLuint fullscreenVAO = 0;
+    GLuint volumeVAO = 0;
+    GLuint volumeBuffers[3]; // Vertices, indices, lights
+    int volumeIndexCount = 0;
+    std::vector<PointLightOrbit> orbits;
+    std::vector<PointLight> lights;
+    GLuint outputFramebuffer = 0; // Where lighting lands: the window, or the headless FBO
+
+    void create() {
+        gbuffer.create();
+        ambientShader.create(fullscreenVertexShaderSource, deferredAmbientFragmentShaderSource);
+        lightShader.create(lightVolumeVertexShaderSource, lightVolumeFragmentShaderSource);
+        glGenVertexArrays(1, &fullscreenVAO);
+
+        // A coarse sphere's faces lie inside the sphere through its vertices; push them out so the
+        // volume still covers the whole light radius
+        float coverage = 1.0f / (std::cos(PI / LIGHT_VOLUME_STACKS) * std::cos(PI / LIGHT_VOLUME_SLICES));
+        SphereMesh volume = buildSphereMesh(coverage, LIGHT_VOLUME_STACKS, LIGHT_VOLUME_SLICES, false);
+        volumeIndexCount = (int)volume.indices.size();
+
+        glGenVertexArrays(1, &volumeVAO);
+        glGenBuffers(3, volumeBuffers);
+        glState.bindVertexArray(volumeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, volumeBuffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, volume.vertices.size() * sizeof(float), volume.vertices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeBuffers[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, volume.indices.size() * sizeof(unsigned int), volume.indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, volumeBuffers[2]);
+        glBufferData(GL_ARRAY_BUFFER, MAX_POINT_LIGHTS * sizeof(PointLight), NULL, GL_DYNAMIC_DRAW);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void*)offsetof(PointLight, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void*)offsetof(PointLight, color));
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        glState.bindVertexArray(0);
+
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        orbits.resize(MAX_POINT_LIGHTS);
+        lights.resize(MAX_POINT_LIGHTS);
+        for (int i = 0; i < MAX_POINT_LIGHTS; ++i) {
+            orbits[i] = { std::sqrt(unit(rng)), unit(rng) * 2.0f - 1.0f, unit(rng) * 2.0f * PI, 0.2f + unit(rng) };
+            // Saturated colours: one channel at full strength
+            float color[3] = { unit(rng), unit(rng), unit(rng) };
+            float brightest = std::max(color[0], std::max(color[1], color[2]));
+            for (int c = 0; c < 3; ++c) lights[i].color[c] = color[c] / brightest;
+        }
+    }
+
+    // Place the first `count` lights for this frame and upload them
+    void animate(int count, float time, float spread, float radius) {
+        for (int i = 0; i < count; ++i) {
+            const PointLightOrbit& o = orbits[i];
+            float angle = o.phase + o.speed * time;
+            lights[i].position[0] = std::cos(angle) * o.orbit * spread;
+            lights[i].position[1] = o.height * spread * 0.5f;
+            lights[i].position[2] = std::sin(angle) * o.orbit * spread;
+            lights[i].radius = radius;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, volumeBuffers[2]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(PointLight), lights.data());
+    }
+
+    // Redirect the surface draws that follow into the G-buffer
+    void beginGeometryPass(int width, int height) {
+        gbuffer.resize(width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, gbuffer.fbo);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // Shade into the (already cleared) output framebuffer
+    void lightingPass(const Mat4& viewProjection, int lightCount) {
+        Mat4 inverseViewProjection = viewProjection.inverse();
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        glDisable(GL_DEPTH_TEST);
+        gbuffer.bindTextures();
+
+        ambientShader.program.set(ambientShader.inverseViewProjection, inverseViewProjection);
+        ambientShader.program.use();
+        glState.bindVertexArray(fullscreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        if (lightCount > 0) {
+            // The sphere winds clockwise seen from outside, so culling back faces keeps the far hemisphere
+            glEnable(GL_CULL_FACE);
+            glCullFace(GL_BACK);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            lightShader.program.set(lightShader.inverseViewProjection, inverseViewProjection);
+            lightShader.program.use();
+            glState.bindVertexArray(volumeVAO);
+            glDrawElementsInstanced(GL_TRIANGLES, volumeIndexCount, GL_UNSIGNED_INT, (void*)0, lightCount);
+            glDisable(GL_BLEND);
+            glDisable(GL_CULL_FACE);
+        }
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void destroy() {
+        gbuffer.destroy();
+        ambientShader.destroy();
+        lightShader.destroy();
+        glDeleteVertexArrays(1, &fullscreenVAO);
+        glDeleteVertexArrays(1, &volumeVAO);
+        glDeleteBuffers(3, volumeBuffers);
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------
+// Submission Path Benchmark
+// ---------------------------------------------------------------------------------------------------------
+// Renders the instance grid for every (path, tessellation, object count) with vsync off and
+// records CPU submission time, GPU time (GL_TIME_ELAPSED) and wall time per frame up to glFinish.
+// The per-object paths set the model matrix uniform per draw; "multidraw" pre-transforms every
+// object into one static batch (with transformPoints/transformNormals) and submits it with a
+// single glMultiDrawElementsBaseVertex. Configurations over the triangle budgets are skipped.
+enum BenchmarkPath { BENCH_IMMEDIATE, BENCH_VBO, BENCH_INDEXED, BENCH_STRIP, BENCH_INSTANCED, BENCH_MULTIDRAW, BENCH_PATH_COUNT };
+const char* benchmarkPathNames[BENCH_PATH_COUNT] = { "immediate", "vbo", "indexed", "strip", "instanced", "multidraw" };
+const int BENCHMARK_TESSELLATIONS[] = { 8, 16, 32, 64, 128 };
+const int BENCHMARK_OBJECT_COUNTS[] = { 1, 16, 256, 4096 };
+const long long BENCHMARK_MAX_TRIANGLES = 16 * 1000 * 1000;         // Per frame, all paths
+const long long BENCHMARK_MAX_IMMEDIATE_TRIANGLES = 2 * 1000 * 1000; // Per frame, glBegin path
+const size_t BENCHMARK_MAX_BATCH_BYTES = 256u << 20;                 // Static batch for multidraw
+
+struct BenchmarkContext {
+    GLFWwindow* window; // NULL when headless
+    SphereBuffers& sphereBuffers;
+    InstanceBuffer& instanceBuffer;
+    ShaderProgram& phongProgram;
+    UniformHandle<Mat4> modelUniform;
+    UniformHandle<Mat3> normalMatrixUniform;
+    ShaderProgram& instancedProgram;
+};
+
+// Object i's model matrix, as laid out by layoutInstanceGrid
+Mat4 instanceModel(const InstanceData& instance) {
+    Mat4 model;
+    std::memcpy(&model.m[0][0], instance.model, sizeof(instance.model));
+    return model;
+}
+
+bool runBenchmarkSweep(BenchmarkContext& context, const char* csvPath, int frames, int warmupFrames) {
+    std::ofstream csv(csvPath);
+    if (!csv) {
+        std::cout << "ERROR::BENCHMARK: cannot write " << csvPath << std::endl;
+        return false;
+    }
+    csv << "path,stacks,slices,objects,triangles,frames,cpu_submit_ms,gpu_ms,frame_ms,status\n";
+    std::cout << "Benchmark: " << frames << " frames per configuration (+" << warmupFrames << " warm-up), writing " << csvPath << std::endl;
+
+    glfwSwapInterval(0); // Vsync off
+    GLuint query;
+    glGenQueries(1, &query);
+
+    // Static batch for the multidraw path: separate position and normal streams, so the batch
+    // transforms write straight into them
+    GLuint batchVAO, batchBuffers[2];
+    glGenVertexArrays(1, &batchVAO);
+    glGenBuffers(2, batchBuffers);
+    glState.bindVertexArray(batchVAO);
+    for (GLuint attribute = 0; attribute < 2; ++attribute) {
+        glBindBuffer(GL_ARRAY_BUFFER, batchBuffers[attribute]);
+        glVertexAttribPointer(attribute, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(attribute);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.sphereBuffers.buffers[SphereBuffers::BUFFER_INDICES]);
+    glState.bindVertexArray(0);
+
+    for (int tessellation : BENCHMARK_TESSELLATIONS) {
+        generateSphere(1.0f, tessellation, tessellation);
+        context.sphereBuffers.upload();
+
+        for (int objects : BENCHMARK_OBJECT_COUNTS) {
+            layoutInstanceGrid(context.instanceBuffer, objects);
+            context.instanceBuffer.upload();
+            long long triangles = (long long)objects * (sphereIndexCount / 3);
+            size_t batchBytes = (size_t)objects * sphereVertexCount * 6 * sizeof(float);
+
+            // Pre-transformed copies of the sphere for the multidraw path
+            std::vector<GLsizei> counts;
+            std::vector<const void*> offsets;
+            std::vector<GLint> baseVertices;
+            if (triangles <= BENCHMARK_MAX_TRIANGLES && batchBytes <= BENCHMARK_MAX_BATCH_BYTES) {
+                std::vector<Vec3> positions(sphereVertexCount), normals(sphereVertexCount);
+                for (int v = 0; v < sphereVertexCount; ++v) {
+                    positions[v] = Vec3(sphereVertices[v * 6], sphereVertices[v * 6 + 1], sphereVertices[v * 6 + 2]);
+                    normals[v] = Vec3(sphereVertices[v * 6 + 3], sphereVertices[v * 6 + 4], sphereVertices[v * 6 + 5]);
+                }
+                std::vector<Vec3> batchPositions((size_t)objects * sphereVertexCount), batchNormals((size_t)objects * sphereVertexCount);
+                for (int i = 0; i < objects; ++i) {
+                    Mat4 model = instanceModel(context.instanceBuffer.instances[i]);
+                    transformPoints(model, positions.data(), &batchPositions[(size_t)i * sphereVertexCount], sphereVertexCount);
+                    transformNormals(normalMatrix(model), normals.data(), &batchNormals[(size_t)i * sphereVertexCount], sphereVertexCount);
+                    counts.push_back(sphereIndexCount);
+                    offsets.push_back((const void*)0);
+                    baseVertices.push_back(i * sphereVertexCount);
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, batchBuffers[0]);
+                glBufferData(GL_ARRAY_BUFFER, batchPositions.size() * sizeof(Vec3), batchPositions.data(), GL_STATIC_DRAW);
+                glBindBuffer(GL_ARRAY_BUFFER, batchBuffers[1]);
+                glBufferData(GL_ARRAY_BUFFER, batchNormals.size() * sizeof(Vec3), batchNormals.data(), GL_STATIC_DRAW);
+            }
+
+            for (int path = 0; path < BENCH_PATH_COUNT; ++path) {
+                bool skip = triangles > BENCHMARK_MAX_TRIANGLES
+                    || (path == BENCH_IMMEDIATE && triangles > BENCHMARK_MAX_IMMEDIATE_TRIANGLES)
+                    || (path == BENCH_MULTIDRAW && counts.empty());
+                if (skip) {
+                    csv << benchmarkPathNames[path] << "," << tessellation << "," << tessellation << "," << objects << "," << triangles
+                        << ",0,,,,skipped\n";
+                    continue;
+                }
+
+                double cpuTotal = 0.0, gpuTotal = 0.0, frameTotal = 0.0;
+                for (int frame = 0; frame < warmupFrames + frames; ++frame) {
+                    if (context.window && glfwWindowShouldClose(context.window)) {
+                        std::cout << "Benchmark aborted." << std::endl;
+                        return false;
+                    }
+                    auto frameStart = std::chrono::steady_clock::now();
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    glBeginQuery(GL_TIME_ELAPSED, query);
+
+                    auto submitStart = std::chrono::steady_clock::now();
+                    if (path == BENCH_INSTANCED) {
+                        context.instancedProgram.use();
+                        context.sphereBuffers.draw(DRAW_INDEXED, objects);
+                    } else if (path == BENCH_MULTIDRAW) {
+                        context.phongProgram.set(context.modelUniform, Mat4::identity());
+                        context.phongProgram.set(context.normalMatrixUniform, Mat3::identity());
+                        context.phongProgram.use();
+                        glState.bindVertexArray(batchVAO);
+                        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), objects, baseVertices.data());
+                    } else {
+                        int mode = path == BENCH_IMMEDIATE ? DRAW_IMMEDIATE : path == BENCH_VBO ? DRAW_ARRAYS : path == BENCH_INDEXED ? DRAW_INDEXED : DRAW_STRIP;
+                        context.phongProgram.use();
+                        for (int i = 0; i < objects; ++i) {
+                            Mat4 model = instanceModel(context.instanceBuffer.instances[i]);
+                            context.phongProgram.set(context.modelUniform, model);
+                            context.phongProgram.set(context.normalMatrixUniform, normalMatrix(model));
+                            context.sphereBuffers.draw(mode);
+                        }
+                    }
+                    auto submitEnd = std::chrono::steady_clock::now();
+
+                    glEndQuery(GL_TIME_ELAPSED);
+                    glFinish();
+                    auto frameEnd = std::chrono::steady_clock::now();
+                    GLuint64 gpuNanoseconds = 0;
+                    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuNanoseconds);
+
+                    if (context.window) {
+                        glfwSwapBuffers(context.window);
+                        glfwPollEvents();
+                    }
+
+                    if (frame < warmupFrames) continue;
+                    cpuTotal += std::chrono::duration<double, std::milli>(submitEnd - submitStart).count();
+                    frameTotal += std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+                    gpuTotal += gpuNanoseconds / 1e6;
+                }
+
+                csv << benchmarkPathNames[path] << "," << tessellation << "," << tessellation << "," << objects << "," << triangles << ","
+                    << frames << "," << cpuTotal / frames << "," << gpuTotal / frames << "," << frameTotal / frames << ",ok\n";
+                std::cout << std::left << std::setw(10) << benchmarkPathNames[path] << " " << std::right << std::setw(3) << tessellation
+                          << "x" << std::setw(3) << tessellation << " x" << std::setw(5) << objects << "  cpu " << std::fixed
+                          << std::setprecision(3) << cpuTotal / frames << " ms  gpu " << gpuTotal / frames << " ms  frame "
+                          << frameTotal / frames << " ms" << std::defaultfloat << std::endl;
+            }
+        }
+    }
+
+    glDeleteQueries(1, &query);
+    glDeleteVertexArrays(1, &batchVAO);
+    glDeleteBuffers(2, batchBuffers);
+    return true;
+}
+
+// Forward declarations
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void processInput(GLFWwindow *window);
+
+// Settings
+const unsigned int SCR_WIDTH = 1280;
+const unsigned int SCR_HEIGHT = 720;
+
+int main(int argc, char** argv)
+{
+    // Command line: --benchmark [report.csv], plus the headless options (--frames also sets the
+    // benchmark's frames per configuration)
+    const char* benchmarkOutput = NULL;
+    int benchmarkFrames = 20;
+    HeadlessOptions headless;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--benchmark") {
+            benchmarkOutput = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "benchmark.csv";
+        } else if (parseHeadlessOption(argc, argv, i, headless)) {
+            if (arg == "--frames") benchmarkFrames = headless.frames;
+        } else {
+            std::cout << "Usage: " << argv[0] << " [--benchmark [report.csv]] " << HEADLESS_USAGE << std::endl;
+            return -1;
+        }
+    }
+    CameraScript cameraScript;
+    if (!headless.cameraScript.empty() && !cameraScript.load(headless.cameraScript)) {
+        std::cout << "Failed to read camera script " << headless.cameraScript << std::endl;
+        return -1;
+    }
+
+    // Headless: an offscreen EGL context replaces GLFW entirely
+    // ---------------------------------------------------------
+    HeadlessContext headlessContext;
+    GLFWwindow* window = NULL;
+    if (headless.enabled) {
+        if (!headlessContext.create(headless.width, headless.height, 3, 3, false)) return -1;
+    } else {
+        // glfw: initialize and configure
+        // ------------------------------
+        if (!glfwInit())
+            return -1;
+
+        // Use Compatibility Profile for legacy OpenGL support (glVertex)
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        if (benchmarkOutput) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "CG HW3: Phong Shading & VBO", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSwapInterval(1); // Enable vsync
+    }
+
+    // Setup Dear ImGui context
+    // ------------------------
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr; // Disable saving .ini file
+    ImGui::StyleColorsDark();
+
+    // Setup Platform/Renderer backends. Headless runs still build the UI every frame (it drives the
+    // same state) but never draw it, so they only need the font atlas built
+    if (headless.enabled) {
+        unsigned char* fontPixels;
+        int fontWidth, fontHeight;
+        io.Fonts->GetTexDataAsRGBA32(&fontPixels, &fontWidth, &fontHeight);
+        io.DisplaySize = ImVec2((float)headless.width, (float)headless.height);
+    } else {
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330");
+    }
+
+    // Load OpenGL functions
+    loadOpenGLFunctions(headless.enabled ? HeadlessContext::getProcAddress : glfwGetProcAddress);
+#ifdef CGHW3_GL_TRACE
+    traceOpenGLFunctions();
+#endif
+    std::cout << "OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
+    programCache.init();
+
+    // Math Library Verification
+    // -------------------------
+    std::cout << "Verifying Math Library..." << std::endl;
+    Vec3 v1(1.0f, 0.0f, 0.0f);
+    Vec3 v2(0.0f, 1.0f, 0.0f);
+    Vec3 v3 = v1.cross(v2);
+    std::cout << "Cross Product (1,0,0)x(0,1,0) = (" << v3.x << ", " << v3.y << ", " << v3.z << ")" << std::endl;
+    
     Mat4 trans = Mat4::translate(Vec3(1.0f, 2.0f, 3.0f));
     std::cout << "Translation Matrix (1,2,3) [3][0]: " << trans.m[3][0] << std::endl;
 
+    Mat4 affine = Mat4::translate(Vec3(1.0f, 2.0f, 3.0f)) * Mat4::rotate(0.7f, Vec3(0.5f, 1.0f, 0.0f)) * Mat4::scale(Vec3(2.0f, 1.0f, 0.5f));
+    Mat4 projectionCheck = Mat4::perspective(45.0f * PI / 180.0f, 16.0f / 9.0f, 0.1f, 100.0f) * affine;
+    Mat4 checks[3] = { affine * affine.inverse(), affine * affine.inverseAffine(), projectionCheck * projectionCheck.inverse() };
+    float maxError = 0.0f;
+    for (const Mat4& check : checks)
+        for (int col = 0; col < 4; ++col)
+            for (int row = 0; row < 4; ++row)
+                maxError = std::max(maxError, std::fabs(check.m[col][row] - (col == row ? 1.0f : 0.0f)));
+    std::cout << "Inverse check max |M * M^-1 - I| = " << maxError << std::endl;
+
     // Generate Sphere
     // ---------------
-    generateSphere(1.0f, 20, 20);
-    std::cout << "Generated Sphere with " << sphereVertexCount << " vertices." << std::endl;
+    int sphereStacks = 20;
+    int sphereSlices = 20;
+    float sphereBuildMs = 0.0f;
+    generateSphere(1.0f, sphereStacks, sphereSlices);
+    std::cout << "Generated Sphere with " << sphereVertexCount << " vertices, " << sphereIndexCount / 3 << " triangles (ACMR "
+              << sphereACMRBefore << " -> " << sphereACMRAfter << ")." << std::endl;
 
     // Shader Compilation Verification
     // -------------------------------
-    unsigned int shaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
-    std::cout << "Shader Program Created with ID: " << shaderProgram << std::endl;
-
-    // VBO/VAO Setup
-    // -------------
-    unsigned int VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * sizeof(float), sphereVertices.data(), GL_STATIC_DRAW);
+    SurfaceShader phongShader;
+    phongShader.create(vertexShaderSource, fragmentShaderSource, false);
+    std::cout << "Shader Program Created with ID: " << phongShader.program.id << " (" << phongShader.program.uniforms.size() << " default-block uniforms) in "
+              << programCache.lastLoadMs << " ms" << (programCache.lastHit ? " from the binary cache" : "") << std::endl;
+    SurfaceShader instancedShader;
+    instancedShader.create(instancedVertexShaderSource, fragmentShaderSource, true);
+    SurfaceShader gbufferShader, gbufferInstancedShader;
+    gbufferShader.create(vertexShaderSource, gbufferFragmentShaderSource, false);
+    gbufferInstancedShader.create(instancedVertexShaderSource, gbufferFragmentShaderSource, true);
+
+    UniformBuffer<CameraBlock> cameraUBO;
+    UniformBuffer<LightBlock> lightUBO;
+    UniformBuffer<MaterialBlock> materialUBO;
+    cameraUBO.create(BINDING_CAMERA);
+    lightUBO.create(BINDING_LIGHT);
+    materialUBO.create(BINDING_MATERIAL);
+
+    // VBO/VAO/EBO Setup
+    // -----------------
+    InstanceBuffer instanceBuffer;
+    instanceBuffer.create();
+    SphereBuffers sphereBuffers;
+    sphereBuffers.create(instanceBuffer);
+    sphereBuffers.upload();
+
+    SphereLODChain sphereLOD;
+    sphereLOD.create(1.0f);
+
+    StreamBuffer streamBuffer;
+    DeformableSphere deformableSphere;
+    deformableSphere.create();
+    DeferredRenderer deferred;
+    deferred.create();
+
+    // Multi-draw indirect: every LOD level in one arena, drawn by storage-buffer shaders
+    GLint glMajor = 0, glMinor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &glMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &glMinor);
+    bool multiDrawSupported = glMultiDrawElementsIndirect && (glMajor > 4 || (glMajor == 4 && glMinor >= 3))
+                           && (headless.enabled ? headlessContext.extensionSupported("GL_ARB_shader_draw_parameters")
+                                                : glfwExtensionSupported("GL_ARB_shader_draw_parameters"));
+    MeshArena meshArena;
+    int lodMeshes[SPHERE_LOD_LEVELS] = {};
+    ShaderProgram multiDrawProgram, gbufferMultiDrawProgram;
+    GLint storageAlignment = 256;
+    if (multiDrawSupported) {
+        for (int level = 0; level < SPHERE_LOD_LEVELS; ++level) {
+            int segments = sphereLOD.levels[level].segments;
+            lodMeshes[level] = meshArena.add(buildSphereMesh(1.0f, segments, segments, false));
+        }
+        meshArena.upload();
+        multiDrawProgram.create(multiDrawVertexShaderSource, fragmentShaderSource);
+        gbufferMultiDrawProgram.create(multiDrawVertexShaderSource, gbufferFragmentShaderSource);
+        for (ShaderProgram* program : { &multiDrawProgram, &gbufferMultiDrawProgram }) {
+            program->bindBlock("Camera", BINDING_CAMERA);
+            program->bindBlock("Light", BINDING_LIGHT);
+            program->bindBlock("Material", BINDING_MATERIAL);
+        }
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    }
+    GLint uniformAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
 
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // Normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // Streaming ring: persistent mapping needs GL 4.4 or ARB_buffer_storage, a proc address proves nothing
+    bool bufferStorageSupported = (glMajor > 4 || (glMajor == 4 && glMinor >= 4))
+                               || (headless.enabled ? headlessContext.extensionSupported("GL_ARB_buffer_storage")
+                                                    : glfwExtensionSupported("GL_ARB_buffer_storage"));
+    streamBuffer.create(1 << 20, bufferStorageSupported, std::max(uniformAlignment, storageAlignment));
 
     // Main loop
     // ---------
-    bool useVBO = true;
-    while (!glfwWindowShouldClose(window))
+    int drawMode = DRAW_INDEXED;
+    bool useLOD = false;
+    bool geomorph = true;
+    float targetEdgePixels = 8.0f;
+    float objectDistance = 0.0f;
+    int lodLevel = 0;
+    float lodMorph = 1.0f;
+    float lodProjectedRadius = 0.0f;
+    bool useInstancing = false;
+    int instanceCount = 1000;
+    int animatedPerFrame = 100;
+    size_t animationCursor = 0;
+    bool useDeformation = false;
+    float deformAmplitude = 0.1f;
+    Scene scene;
+    bool useScene = false;
+    int sceneObjects = 20000;
+    bool animateScene = true;
+    bool useBVH = true;
+    bool useSIMDCulling = true;
+    float cameraYaw = 0.0f;
+    float cullMs = 0.0f;
+    bool useMultiDrawIndirect = false;
+    int indirectLevelCounts[SPHERE_LOD_LEVELS] = {};
+    bool useDeferred = false;
+    int pointLightCount = 256;
+    float pointLightRadius = 0.5f;
+    float pointLightSpread = 3.0f;
+    layoutInstanceGrid(instanceBuffer, instanceCount);
+    if (headless.enabled) deferred.outputFramebuffer = headlessContext.framebuffer;
+
+    // Benchmark mode: run the sweep with the default camera, light and material, then exit
+    if (benchmarkOutput) {
+        int width = headless.width, height = headless.height;
+        if (headless.enabled) headlessContext.beginFrame();
+        else glfwGetFramebufferSize(window, &width, &height);
+        glViewport(0, 0, width, height);
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glEnable(GL_DEPTH_TEST);
+
+        Mat4 projection = Mat4::perspective(45.0f * PI / 180.0f, (float)width / (float)height, 0.1f, 100.0f);
+        Mat4 view = Mat4::translate(Vec3(0.0f, 0.0f, -3.0f));
+        CameraBlock camera = { {}, {}, { 0.0f, 0.0f, 3.0f }, 0.0f };
+        std::memcpy(camera.view, view.value_ptr(), sizeof(camera.view));
+        std::memcpy(camera.projection, projection.value_ptr(), sizeof(camera.projection));
+        cameraUBO.update(camera);
+        lightUBO.update({ { 1.2f, 1.0f, 2.0f }, 0.0f, { 1.0f, 1.0f, 1.0f }, 0.0f });
+        materialUBO.update({ { 1.0f, 0.5f, 0.31f }, 32.0f });
+        phongShader.program.set(phongShader.morph, 1.0f);
+
+        BenchmarkContext context = { window, sphereBuffers, instanceBuffer, phongShader.program, phongShader.model, phongShader.normalMatrix, instancedShader.program };
+        runBenchmarkSweep(context, benchmarkOutput, benchmarkFrames, 3);
+        if (window) glfwSetWindowShouldClose(window, true);
+        headless.frames = 0;
+    }
+
+    // Headless runs step a fixed clock and take the script's keys: time, yaw, distance, lights, and
+    // 0/1 switches scene, deferred, lod, instancing, indirect
+    for (int frame = 0; headless.enabled ? frame < headless.frames : !glfwWindowShouldClose(window); ++frame)
     {
+        float headlessTime = frame / headless.fps;
+        if (headless.enabled) {
+            float f = (float)frame;
+            headlessTime = cameraScript.value("time", f, headlessTime);
+            cameraYaw = cameraScript.value("yaw", f, cameraYaw);
+            objectDistance = cameraScript.value("distance", f, objectDistance);
+            pointLightCount = std::clamp((int)cameraScript.value("lights", f, (float)pointLightCount), 0, MAX_POINT_LIGHTS);
+            useDeferred = cameraScript.value("deferred", f, useDeferred) > 0.5f;
+            useLOD = cameraScript.value("lod", f, useLOD) > 0.5f;
+            useInstancing = cameraScript.value("instancing", f, useInstancing) > 0.5f;
+            useMultiDrawIndirect = multiDrawSupported && cameraScript.value("indirect", f, useMultiDrawIndirect) > 0.5f;
+            bool sceneWanted = cameraScript.value("scene", f, useScene) > 0.5f;
+            if (sceneWanted != useScene) {
+                useScene = sceneWanted;
+                if (useScene && scene.size() != sceneObjects) scene.generate(sceneObjects, 1);
+                if (!useScene) layoutInstanceGrid(instanceBuffer, instanceCount);
+            }
+        }
+
         // Input
-        processInput(window);
+        if (!headless.enabled) processInput(window);
 
         // Start the Dear ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
+        if (headless.enabled) {
+            io.DeltaTime = 1.0f / headless.fps;
+        } else {
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+        }
         ImGui::NewFrame();
 
         static float lightPos[3] = {1.2f, 1.0f, 2.0f};
@@ -547,8 +3338,112 @@ int main()
         {
             ImGui::Begin("Control Panel");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-            ImGui::Checkbox("Use VBO", &useVBO);
+            ImGui::Text("State changes: %u issued, %u skipped", glState.issuedCalls, glState.skippedCalls);
+            ImGui::Combo("Draw Mode", &drawMode, drawModeNames, IM_ARRAYSIZE(drawModeNames));
+
+            ImGui::Separator();
+            ImGui::Text("Sphere Tessellation");
+            bool retessellate = ImGui::SliderInt("Stacks", &sphereStacks, 3, 2048);
+            retessellate |= ImGui::SliderInt("Slices", &sphereSlices, 3, 2048);
+            if (retessellate) {
+                auto start = std::chrono::steady_clock::now();
+                generateSphere(1.0f, sphereStacks, sphereSlices);
+                sphereBuffers.upload();
+                sphereBuildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+            ImGui::Text("Vertices: %d (%d if unindexed)", sphereVertexCount, sphereIndexCount);
+            ImGui::Text("Triangles: %d", sphereIndexCount / 3);
+            if (sphereStreamed) {
+                ImGui::Text("Streamed to GPU, unoptimized (over %d vertices)", SPHERE_OPTIMIZE_MAX_VERTICES);
+                ImGui::TextDisabled("(immediate and arrays modes draw indexed, no deformation)");
+            } else {
+                ImGui::Text("ACMR (cache %d): %.3f -> %.3f", VERTEX_CACHE_SIZE, sphereACMRBefore, sphereACMRAfter);
+            }
+            ImGui::Text("Build + upload: %.1f ms", sphereBuildMs);
+            int vertexFormatChoice = sphereBuffers.format;
+            if (ImGui::Combo("Vertex Format", &vertexFormatChoice, vertexFormatNames, IM_ARRAYSIZE(vertexFormatNames))) {
+                sphereBuffers.setFormat(vertexFormatChoice);
+            }
+            ImGui::Text("Vertex buffer: %.1f KB (%d B/vertex)", sphereBuffers.vertexBytes / 1024.0f, vertexFormatStrides[sphereBuffers.format]);
+
+            ImGui::Separator();
+            ImGui::Text("Level of Detail");
+            ImGui::SliderFloat("Object Distance", &objectDistance, 0.0f, 90.0f);
+            ImGui::Checkbox("Use LOD Chain", &useLOD);
+            if (useLOD) {
+                ImGui::SameLine();
+                ImGui::Checkbox("Geomorph", &geomorph);
+                ImGui::SliderFloat("Target Edge (px)", &targetEdgePixels, 1.0f, 64.0f);
+                int segments = sphereLOD.levels[lodLevel].segments;
+                ImGui::Text("Projected radius %.1f px -> level %d (%dx%d, %d tris), morph %.2f",
+                            lodProjectedRadius, lodLevel, segments, segments, sphereLOD.levels[lodLevel].indexCount / 3, lodMorph);
+            }
             
+            ImGui::Separator();
+            ImGui::Text("Instancing");
+            ImGui::Checkbox("Instanced Grid", &useInstancing);
+            if (useInstancing) {
+                if (ImGui::SliderInt("Instances", &instanceCount, 1, 100000, "%d", ImGuiSliderFlags_Logarithmic)) {
+                    layoutInstanceGrid(instanceBuffer, instanceCount);
+                }
+                ImGui::SliderInt("Animated / Frame", &animatedPerFrame, 0, instanceCount);
+                ImGui::Text("Upload: %d call(s), %.1f KB", instanceBuffer.uploadCalls, instanceBuffer.uploadedBytes / 1024.0f);
+                if (drawMode == DRAW_IMMEDIATE || useLOD) ImGui::TextDisabled("(needs a buffer draw mode and LOD off)");
+            }
+
+            ImGui::Separator();
+            ImGui::Text("Scene Culling");
+            if (ImGui::Checkbox("Culled Scene", &useScene)) {
+                if (useScene && scene.size() != sceneObjects) scene.generate(sceneObjects, 1);
+                if (!useScene) layoutInstanceGrid(instanceBuffer, instanceCount);
+            }
+            if (useScene) {
+                if (ImGui::SliderInt("Objects", &sceneObjects, 1, 200000, "%d", ImGuiSliderFlags_Logarithmic)) {
+                    scene.generate(sceneObjects, 1);
+                }
+                ImGui::SliderFloat("Camera Yaw", &cameraYaw, -PI, PI);
+                ImGui::Checkbox("Animate", &animateScene);
+                ImGui::SameLine();
+                ImGui::Checkbox("BVH", &useBVH);
+                ImGui::SameLine();
+                ImGui::Checkbox("SIMD", &useSIMDCulling);
+                if (multiDrawSupported) {
+                    ImGui::Checkbox("Multi-Draw Indirect", &useMultiDrawIndirect);
+                } else {
+                    ImGui::TextDisabled("(multi-draw indirect needs GL 4.3 + ARB_shader_draw_parameters)");
+                }
+                if (useMultiDrawIndirect) {
+                    ImGui::SliderFloat("Target Edge (px)##indirect", &targetEdgePixels, 1.0f, 64.0f);
+                    ImGui::Text("1 draw, %d commands; arena %.1f KB", (int)scene.visible.size(), meshArena.bytes() / 1024.0f);
+                    ImGui::Text("Objects per LOD level: %d %d %d %d %d %d", indirectLevelCounts[0], indirectLevelCounts[1],
+                                indirectLevelCounts[2], indirectLevelCounts[3], indirectLevelCounts[4], indirectLevelCounts[5]);
+                }
+                ImGui::Text("Visible %d, culled %d (%d nodes visited)", (int)scene.visible.size(),
+                            scene.size() - (int)scene.visible.size(), scene.nodesVisited);
+                ImGui::Text("Animate + refit + cull: %.3f ms", cullMs);
+            }
+
+            ImGui::Separator();
+            ImGui::Text("Streaming");
+            ImGui::Checkbox("Deformable Sphere", &useDeformation);
+            if (useDeformation) {
+                ImGui::SliderFloat("Amplitude", &deformAmplitude, 0.0f, 0.5f);
+                ImGui::Text("Ring: %d x %.1f KB (%s), %.1f KB used", STREAM_FRAMES, streamBuffer.frameSize / 1024.0f,
+                            streamBuffer.persistent ? "persistent" : "mapped per frame", streamBuffer.usedBytes / 1024.0f);
+                ImGui::Text("Fence stalls: %u", streamBuffer.stalls);
+            }
+
+            ImGui::Separator();
+            ImGui::Text("Deferred Shading");
+            ImGui::Checkbox("Deferred", &useDeferred);
+            if (useDeferred) {
+                ImGui::SliderInt("Point Lights", &pointLightCount, 0, MAX_POINT_LIGHTS);
+                ImGui::SliderFloat("Light Radius", &pointLightRadius, 0.05f, 10.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+                ImGui::SliderFloat("Light Spread", &pointLightSpread, 0.5f, SCENE_EXTENT, "%.1f", ImGuiSliderFlags_Logarithmic);
+                ImGui::Text("G-buffer %dx%d, %.1f MB", deferred.gbuffer.width, deferred.gbuffer.height, deferred.gbuffer.bytes() / (1024.0f * 1024.0f));
+                ImGui::Text("Light volumes: %d instances x %d tris", pointLightCount, deferred.volumeIndexCount / 3);
+            }
+
             ImGui::Separator();
             ImGui::Text("Light Settings");
             ImGui::DragFloat3("Light Position", lightPos, 0.1f);
@@ -562,58 +3457,117 @@ int main()
             ImGui::End();
         }
 
+#ifdef CGHW3_GL_TRACE
+        glTrace.drawOverlay();
+#endif
+
         // Rendering
         ImGui::Render();
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        int display_w = headless.width, display_h = headless.height;
+        if (headless.enabled) headlessContext.beginFrame();
+        else glfwGetFramebufferSize(window, &display_w, &display_h);
         glViewport(0, 0, display_w, display_h);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear depth buffer too
         glEnable(GL_DEPTH_TEST); // Enable depth testing
 
-        glUseProgram(shaderProgram);
-
-        // Set Uniforms
-        // Light Position
-        glUniform3f(glGetUniformLocation(shaderProgram, "lightPos"), lightPos[0], lightPos[1], lightPos[2]);
-        // View Position (Camera)
-        glUniform3f(glGetUniformLocation(shaderProgram, "viewPos"), 0.0f, 0.0f, 3.0f);
-        // Light Color
-        glUniform3f(glGetUniformLocation(shaderProgram, "lightColor"), lightColor[0], lightColor[1], lightColor[2]);
-        // Object Color
-        glUniform3f(glGetUniformLocation(shaderProgram, "objectColor"), objectColor[0], objectColor[1], objectColor[2]);
-        // Shininess
-        glUniform1f(glGetUniformLocation(shaderProgram, "shininess"), shininess);
+        glState.issuedCalls = 0;
+        glState.skippedCalls = 0;
+
+        // Only the sphere buffers are quantized; the deformation and LOD paths read floats
+        int sceneDrawMode = drawMode == DRAW_IMMEDIATE ? (int)DRAW_INDEXED : drawMode; // The scene is always instanced
+        int vertexFormat = useDeformation ? (int)VERTEX_FLOAT
+                         : useScene ? sphereBuffers.formatFor(sceneDrawMode)
+                         : useLOD ? (int)VERTEX_FLOAT : sphereBuffers.formatFor(drawMode);
+        SurfaceShader& surface = useDeferred ? gbufferShader : phongShader;
+        SurfaceShader& instancedSurface = useDeferred ? gbufferInstancedShader : instancedShader;
+        instancedSurface.format.apply(instancedSurface.program, vertexFormat, sphereBuffers.quantization);
+        surface.format.apply(surface.program, vertexFormat, sphereBuffers.quantization);
+        surface.program.use();
+        if (useDeferred) deferred.beginGeometryPass(display_w, display_h);
 
         // Transformations
         Mat4 projection = Mat4::perspective(45.0f * PI / 180.0f, (float)display_w / (float)display_h, 0.1f, 100.0f);
         Mat4 view = Mat4::translate(Vec3(0.0f, 0.0f, -3.0f)); // Move camera back
+        if (useScene) view = Mat4::rotate(cameraYaw, Vec3(0.0f, 1.0f, 0.0f)) * view; // Turn in place
         Mat4 model = Mat4::identity();
         
         // Rotate the sphere over time
-        float time = (float)glfwGetTime();
-        model = Mat4::rotate(time, Vec3(0.5f, 1.0f, 0.0f));
-
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, projection.value_ptr());
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, view.value_ptr());
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, model.value_ptr());
-
-        if (useVBO) {
-            glBindVertexArray(VAO);
-            glDrawArrays(GL_TRIANGLES, 0, sphereVertexCount);
+        float time = headless.enabled ? headlessTime : (float)glfwGetTime();
+        model = Mat4::translate(Vec3(0.0f, 0.0f, -objectDistance)) * Mat4::rotate(time, Vec3(0.5f, 1.0f, 0.0f));
+
+        // Set Uniforms: blocks shared by every object, then per-object state
+        CameraBlock camera = {};
+        std::memcpy(camera.view, view.value_ptr(), sizeof(camera.view));
+        std::memcpy(camera.projection, projection.value_ptr(), sizeof(camera.projection));
+        camera.viewPos[2] = 3.0f; // View Position (Camera)
+        cameraUBO.update(camera);
+
+        LightBlock light = {};
+        std::memcpy(light.lightPos, lightPos, sizeof(light.lightPos));
+        std::memcpy(light.lightColor, lightColor, sizeof(light.lightColor));
+        lightUBO.update(light);
+
+        MaterialBlock material = {};
+        std::memcpy(material.objectColor, objectColor, sizeof(material.objectColor));
+        material.shininess = shininess;
+        materialUBO.update(material);
+
+        surface.program.set(surface.model, model);
+        surface.program.set(surface.normalMatrix, normalMatrix(model));
+
+        if (useLOD) {
+            lodProjectedRadius = projectedRadiusPixels(sphereLOD.radius, 3.0f + objectDistance, 45.0f * PI / 180.0f, (float)display_h);
+            lodLevel = sphereLOD.select(lodProjectedRadius, targetEdgePixels, lodMorph);
+            if (!geomorph) lodMorph = 1.0f;
         } else {
-            // Immediate Mode Rendering
-            glBindVertexArray(0); // Unbind VAO
-            
-            glBegin(GL_TRIANGLES);
-            for (int i = 0; i < sphereVertexCount; ++i) {
-                int baseIndex = i * 6;
-                // Normal (Location 1)
-                glVertexAttrib3f(1, sphereVertices[baseIndex + 3], sphereVertices[baseIndex + 4], sphereVertices[baseIndex + 5]);
-                // Position (Location 0) - Using glVertex3f to ensure vertex submission
-                glVertex3f(sphereVertices[baseIndex], sphereVertices[baseIndex + 1], sphereVertices[baseIndex + 2]);
+            lodMorph = 1.0f;
+        }
+        surface.program.set(surface.morph, lodMorph);
+
+        if (useDeformation) {
+            deformableSphere.draw(streamBuffer, time, deformAmplitude, material, uniformAlignment);
+            materialUBO.bind();
+        } else if (useScene) {
+            auto cullStart = std::chrono::steady_clock::now();
+            if (animateScene) scene.animate(time);
+            scene.cull(Frustum::fromMatrix(projection * view), useBVH, useSIMDCulling);
+            cullMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cullStart).count();
+            if (useMultiDrawIndirect) {
+                (useDeferred ? gbufferMultiDrawProgram : multiDrawProgram).use();
+                drawSceneIndirect(scene, meshArena, lodMeshes, sphereLOD, streamBuffer, storageAlignment, Vec3(0.0f, 0.0f, 3.0f),
+                                  45.0f * PI / 180.0f, (float)display_h, targetEdgePixels, indirectLevelCounts);
+            } else {
+                scene.fillInstances(instanceBuffer);
+                instanceBuffer.upload();
+
+                instancedSurface.program.use();
+                if (!scene.visible.empty()) sphereBuffers.draw(sceneDrawMode, (GLsizei)scene.visible.size());
             }
-            glEnd();
+        } else if (useInstancing && !useLOD && drawMode != DRAW_IMMEDIATE) {
+            animateInstances(instanceBuffer, animationCursor, (size_t)animatedPerFrame, time);
+            animationCursor = instanceBuffer.instances.empty() ? 0 : (animationCursor + animatedPerFrame) % instanceBuffer.instances.size();
+            instanceBuffer.upload();
+
+            instancedSurface.program.use();
+            sphereBuffers.draw(drawMode, (GLsizei)instanceBuffer.instances.size());
+        } else if (useLOD) {
+            sphereLOD.draw(lodLevel);
+        } else {
+            sphereBuffers.draw(drawMode);
+        }
+
+        if (useDeferred) {
+            deferred.animate(pointLightCount, time, pointLightSpread, pointLightRadius);
+            deferred.lightingPass(projection * view, pointLightCount);
+        }
+
+#ifdef CGHW3_GL_TRACE
+        glTrace.endFrame();
+#endif
+        if (headless.enabled) {
+            headlessContext.endFrame(frame, headless.outputPrefix);
+            continue;
         }
 
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -621,12 +3575,31 @@ int main()
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+    if (headless.enabled) headlessContext.printTimings();
 
     // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteProgram(shaderProgram);
-
+    sphereBuffers.destroy();
+    sphereLOD.destroy();
+    deformableSphere.destroy();
+    streamBuffer.destroy();
+    deferred.destroy();
+    meshArena.destroy();
+    multiDrawProgram.destroy();
+    gbufferMultiDrawProgram.destroy();
+    instanceBuffer.destroy();
+    instancedShader.destroy();
+    gbufferShader.destroy();
+    gbufferInstancedShader.destroy();
+    cameraUBO.destroy();
+    lightUBO.destroy();
+    materialUBO.destroy();
+    phongShader.destroy();
+
+    if (headless.enabled) {
+        ImGui::DestroyContext();
+        headlessContext.destroy();
+        return 0;
+    }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
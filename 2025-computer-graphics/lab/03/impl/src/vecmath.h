@@ -0,0 +1,547 @@
+#pragma once
+
+// ---------------------------------------------------------------------------------------------------------
+// Minimal Math Library (No GLM)
+// ---------------------------------------------------------------------------------------------------------
+// Matrices are column-major (m[col][row], value_ptr() feeds glUniformMatrix*fv directly). Mat4
+// columns are 16-byte aligned so the SSE/AVX2 paths load them with one instruction each; the
+// scalar fallback is used when neither is enabled at compile time (e.g. ARM builds).
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER)) // MSVC /arch:AVX2 implies FMA but does not define __FMA__
+#define VECMATH_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VECMATH_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined(VECMATH_AVX2) || defined(VECMATH_SSE)
+#define VECMATH_SIMD 1
+#endif
+
+const float PI = 3.14159265359f;
+
+struct Vec3 {
+    float x, y, z;
+
+    Vec3() : x(0), y(0), z(0) {}
+    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    Vec3 operator+(const Vec3& other) const { return Vec3(x + other.x, y + other.y, z + other.z); }
+    Vec3 operator-(const Vec3& other) const { return Vec3(x - other.x, y - other.y, z - other.z); }
+    Vec3 operator*(float scalar) const { return Vec3(x * scalar, y * scalar, z * scalar); }
+    Vec3 operator/(float scalar) const { return Vec3(x / scalar, y / scalar, z / scalar); }
+
+    float dot(const Vec3& other) const { return x * other.x + y * other.y + z * other.z; }
+    
+    Vec3 cross(const Vec3& other) const {
+        return Vec3(
+            y * other.z - z * other.y,
+            z * other.x - x * other.z,
+            x * other.y - y * other.x
+        );
+    }
+
+    float length() const { return std::sqrt(x * x + y * y + z * z); }
+
+    Vec3 normalize() const {
+        float len = length();
+        if (len > 0) return *this / len;
+        return *this;
+    }
+};
+
+// Homogeneous vector, laid out like one Mat4 column
+struct alignas(16) Vec4 {
+    float x, y, z, w;
+
+    Vec4() : x(0), y(0), z(0), w(0) {}
+    Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+    Vec4(const Vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+
+    Vec3 xyz() const { return Vec3(x, y, z); }
+};
+
+struct Mat3 {
+    float m[3][3]; // Column-major: m[col][row]
+
+    Mat3() {
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                m[i][j] = (i == j) ? 1.0f : 0.0f;
+    }
+
+    static Mat3 identity() { return Mat3(); }
+
+    Mat3 transpose() const {
+        Mat3 res;
+        for (int col = 0; col < 3; ++col)
+            for (int row = 0; row < 3; ++row)
+                res.m[col][row] = m[row][col];
+        return res;
+    }
+
+    float determinant() const {
+        return m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2])
+             - m[1][0] * (m[0][1] * m[2][2] - m[2][1] * m[0][2])
+             + m[2][0] * (m[0][1] * m[1][2] - m[1][1] * m[0][2]);
+    }
+
+    // Adjugate over determinant; singular matrices return identity
+    Mat3 inverse() const {
+        float det = determinant();
+        if (std::fabs(det) < 1e-12f) return Mat3();
+        float invDet = 1.0f / det;
+
+        Mat3 res;
+        res.m[0][0] =  (m[1][1] * m[2][2] - m[2][1] * m[1][2]) * invDet;
+        res.m[0][1] = -(m[0][1] * m[2][2] - m[2][1] * m[0][2]) * invDet;
+        res.m[0][2] =  (m[0][1] * m[1][2] - m[1][1] * m[0][2]) * invDet;
+        res.m[1][0] = -(m[1][0] * m[2][2] - m[2][0] * m[1][2]) * invDet;
+        res.m[1][1] =  (m[0][0] * m[2][2] - m[2][0] * m[0][2]) * invDet;
+        res.m[1][2] = -(m[0][0] * m[1][2] - m[1][0] * m[0][2]) * invDet;
+        res.m[2][0] =  (m[1][0] * m[2][1] - m[2][0] * m[1][1]) * invDet;
+        res.m[2][1] = -(m[0][0] * m[2][1] - m[2][0] * m[0][1]) * invDet;
+        res.m[2][2] =  (m[0][0] * m[1][1] - m[1][0] * m[0][1]) * invDet;
+        return res;
+    }
+
+    Mat3 operator*(const Mat3& other) const {
+        Mat3 res;
+        for (int col = 0; col < 3; ++col) {
+            for (int row = 0; row < 3; ++row) {
+                res.m[col][row] = 0.0f;
+                for (int k = 0; k < 3; ++k) {
+                    res.m[col][row] += m[k][row] * other.m[col][k];
+                }
+            }
+        }
+        return res;
+    }
+
+    Vec3 operator*(const Vec3& v) const {
+        return Vec3(
+            m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+            m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+            m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z
+        );
+    }
+
+    const float* value_ptr() const {
+        return &m[0][0];
+    }
+};
+
+struct alignas(16) Mat4 {
+    float m[4][4]; // Column-major: m[col][row]
+
+    // Tag for results that are fully overwritten, skipping the identity fill
+    struct Uninitialized {};
+    explicit Mat4(Uninitialized) {}
+
+    Mat4() {
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                m[i][j] = (i == j) ? 1.0f : 0.0f;
+    }
+
+    static Mat4 identity() { return Mat4(); }
+
+    static Mat4 translate(const Vec3& v) {
+        Mat4 res;
+        res.m[3][0] = v.x;
+        res.m[3][1] = v.y;
+        res.m[3][2] = v.z;
+        return res;
+    }
+
+    static Mat4 scale(const Vec3& v) {
+        Mat4 res;
+        res.m[0][0] = v.x;
+        res.m[1][1] = v.y;
+        res.m[2][2] = v.z;
+        return res;
+    }
+
+    static Mat4 rotate(float angleRadians, const Vec3& axis) {
+        Mat4 res;
+        Vec3 a = axis.normalize();
+        float c = std::cos(angleRadians);
+        float s = std::sin(angleRadians);
+        float t = 1.0f - c;
+
+        res.m[0][0] = c + a.x * a.x * t;
+        res.m[0][1] = a.x * a.y * t + a.z * s;
+        res.m[0][2] = a.x * a.z * t - a.y * s;
+
+        res.m[1][0] = a.y * a.x * t - a.z * s;
+        res.m[1][1] = c + a.y * a.y * t;
+        res.m[1][2] = a.y * a.z * t + a.x * s;
+
+        res.m[2][0] = a.z * a.x * t + a.y * s;
+        res.m[2][1] = a.z * a.y * t - a.x * s;
+        res.m[2][2] = c + a.z * a.z * t;
+
+        return res;
+    }
+
+    static Mat4 perspective(float fovRadians, float aspect, float nearPlane, float farPlane) {
+        Mat4 res;
+        // Zero out
+        for(int i=0; i<4; ++i) for(int j=0; j<4; ++j) res.m[i][j] = 0.0f;
+
+        float tanHalfFovy = std::tan(fovRadians / 2.0f);
+
+        res.m[0][0] = 1.0f / (aspect * tanHalfFovy);
+        res.m[1][1] = 1.0f / tanHalfFovy;
+        res.m[2][2] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+        res.m[2][3] = -1.0f;
+        res.m[3][2] = -(2.0f * farPlane * nearPlane) / (farPlane - nearPlane);
+        
+        return res;
+    }
+
+    static Mat4 lookAt(const Vec3& eye, const Vec3& center, const Vec3& up) {
+        Vec3 f = (center - eye).normalize();
+        Vec3 s = f.cross(up).normalize();
+        Vec3 u = s.cross(f);
+
+        Mat4 res;
+        res.m[0][0] = s.x; res.m[1][0] = s.y; res.m[2][0] = s.z;
+        res.m[0][1] = u.x; res.m[1][1] = u.y; res.m[2][1] = u.z;
+        res.m[0][2] = -f.x; res.m[1][2] = -f.y; res.m[2][2] = -f.z;
+        res.m[3][0] = -s.dot(eye);
+        res.m[3][1] = -u.dot(eye);
+        res.m[3][2] = f.dot(eye);
+        
+        return res;
+    }
+
+    Mat4 operator*(const Mat4& other) const {
+        Mat4 res{Uninitialized()};
+#if defined(VECMATH_AVX2)
+        // Two result columns per iteration: each 128-bit lane of b holds one column of `other`,
+        // and res.col = sum_k this.col[k] * other.col[k]
+        __m256 a0 = _mm256_broadcast_ps((const __m128*)m[0]);
+        __m256 a1 = _mm256_broadcast_ps((const __m128*)m[1]);
+        __m256 a2 = _mm256_broadcast_ps((const __m128*)m[2]);
+        __m256 a3 = _mm256_broadcast_ps((const __m128*)m[3]);
+        for (int col = 0; col < 4; col += 2) {
+            __m256 b = _mm256_loadu_ps(other.m[col]);
+            __m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(b, 0x00));
+            r = _mm256_fmadd_ps(a1, _mm256_permute_ps(b, 0x55), r);
+            r = _mm256_fmadd_ps(a2, _mm256_permute_ps(b, 0xAA), r);
+            r = _mm256_fmadd_ps(a3, _mm256_permute_ps(b, 0xFF), r);
+            _mm256_storeu_ps(res.m[col], r);
+        }
+#elif defined(VECMATH_SSE)
+        __m128 a0 = _mm_load_ps(m[0]);
+        __m128 a1 = _mm_load_ps(m[1]);
+        __m128 a2 = _mm_load_ps(m[2]);
+        __m128 a3 = _mm_load_ps(m[3]);
+        for (int col = 0; col < 4; ++col) {
+            __m128 r = _mm_mul_ps(a0, _mm_set1_ps(other.m[col][0]));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(other.m[col][1])));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(other.m[col][2])));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(other.m[col][3])));
+            _mm_store_ps(res.m[col], r);
+        }
+#else
+        for (int col = 0; col < 4; ++col) {
+            for (int row = 0; row < 4; ++row) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; ++k) {
+                    sum += m[k][row] * other.m[col][k];
+                }
+                res.m[col][row] = sum;
+            }
+        }
+#endif
+        return res;
+    }
+
+    Vec4 operator*(const Vec4& v) const {
+        Vec4 res;
+#if defined(VECMATH_SIMD)
+        __m128 r = _mm_mul_ps(_mm_load_ps(m[0]), _mm_set1_ps(v.x));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m[1]), _mm_set1_ps(v.y)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m[2]), _mm_set1_ps(v.z)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m[3]), _mm_set1_ps(v.w)));
+        _mm_store_ps(&res.x, r);
+#else
+        res.x = m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z + m[3][0] * v.w;
+        res.y = m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z + m[3][1] * v.w;
+        res.z = m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z + m[3][2] * v.w;
+        res.w = m[0][3] * v.x + m[1][3] * v.y + m[2][3] * v.z + m[3][3] * v.w;
+#endif
+        return res;
+    }
+
+    // Affine point transform (w = 1, no perspective divide)
+    Vec3 transformPoint(const Vec3& p) const { return (*this * Vec4(p, 1.0f)).xyz(); }
+
+    // Direction transform (w = 0), ignores translation
+    Vec3 transformVector(const Vec3& v) const { return (*this * Vec4(v, 0.0f)).xyz(); }
+
+    Mat4 transpose() const {
+        Mat4 res;
+        for (int col = 0; col < 4; ++col)
+            for (int row = 0; row < 4; ++row)
+                res.m[col][row] = m[row][col];
+        return res;
+    }
+
+    Mat3 upperLeft() const {
+        Mat3 res;
+        for (int col = 0; col < 3; ++col)
+            for (int row = 0; row < 3; ++row)
+                res.m[col][row] = m[col][row];
+        return res;
+    }
+
+    // General inverse via 2x2 sub-determinants (Laplace expansion); singular matrices return identity
+    Mat4 inverse() const {
+        float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+        float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+        float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+        float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+        float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+        float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+        float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+        float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+        float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+        float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+        float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+        float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+        float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+        if (std::fabs(det) < 1e-12f) return Mat4();
+        float invDet = 1.0f / det;
+
+        Mat4 res;
+        res.m[0][0] = ( m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * invDet;
+        res.m[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * invDet;
+        res.m[0][2] = ( m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * invDet;
+        res.m[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * invDet;
+
+        res.m[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * invDet;
+        res.m[1][1] = ( m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * invDet;
+        res.m[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * invDet;
+        res.m[1][3] = ( m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * invDet;
+
+        res.m[2][0] = ( m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * invDet;
+        res.m[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * invDet;
+        res.m[2][2] = ( m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * invDet;
+        res.m[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * invDet;
+
+        res.m[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * invDet;
+        res.m[3][1] = ( m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * invDet;
+        res.m[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * invDet;
+        res.m[3][3] = ( m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * invDet;
+        return res;
+    }
+
+    // Fast path for affine transforms (last row 0 0 0 1): [A t]^-1 = [A^-1  -A^-1 t]
+    Mat4 inverseAffine() const {
+        Mat3 a = upperLeft().inverse();
+        Vec3 t = a * Vec3(m[3][0], m[3][1], m[3][2]);
+
+        Mat4 res;
+        for (int col = 0; col < 3; ++col)
+            for (int row = 0; row < 3; ++row)
+                res.m[col][row] = a.m[col][row];
+        res.m[3][0] = -t.x;
+        res.m[3][1] = -t.y;
+        res.m[3][2] = -t.z;
+        return res;
+    }
+
+    const float* value_ptr() const {
+        return &m[0][0];
+    }
+};
+
+// Transforms normals of an affine model matrix: transpose(inverse(mat3(model)))
+inline Mat3 normalMatrix(const Mat4& model) {
+    return model.upperLeft().inverse().transpose();
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// Batch Transforms
+// ---------------------------------------------------------------------------------------------------------
+// Vec3 arrays are tightly packed (12-byte stride), so the SIMD paths load 4 points as three 16-byte
+// words (8 points as three 32-byte words with AVX2), transpose them to x/y/z registers, transform
+// and transpose back. `in` and `out` may be the same array.
+
+#if defined(VECMATH_SIMD)
+// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3  ->  x, y, z (per 128-bit lane)
+#define VECMATH_AOS_TO_SOA(SHUFFLE, a, b, c, x, y, z) \
+    x = SHUFFLE(a, SHUFFLE(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0)); \
+    y = SHUFFLE(SHUFFLE(a, b, _MM_SHUFFLE(0, 0, 1, 1)), SHUFFLE(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)); \
+    z = SHUFFLE(SHUFFLE(a, b, _MM_SHUFFLE(1, 1, 2, 2)), c, _MM_SHUFFLE(3, 0, 2, 0));
+
+#define VECMATH_SOA_TO_AOS(SHUFFLE, x, y, z, a, b, c) \
+    a = SHUFFLE(SHUFFLE(x, y, _MM_SHUFFLE(0, 0, 0, 0)), SHUFFLE(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)); \
+    b = SHUFFLE(SHUFFLE(y, z, _MM_SHUFFLE(1, 1, 1, 1)), SHUFFLE(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)); \
+    c = SHUFFLE(SHUFFLE(z, x, _MM_SHUFFLE(3, 3, 2, 2)), SHUFFLE(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+#endif
+
+// out[i] = A * in[i] + t, with A given as columns c[0..2] and t = c[3]
+inline void transformVec3Batch(const float c[4][3], const Vec3* in, Vec3* out, size_t count) {
+    size_t i = 0;
+#if defined(VECMATH_AVX2)
+    __m256 w[4][3];
+    for (int col = 0; col < 4; ++col)
+        for (int row = 0; row < 3; ++row)
+            w[col][row] = _mm256_set1_ps(c[col][row]);
+    for (size_t blocks = count & ~(size_t)7; i < blocks; i += 8) {
+        const float* src = &in[i].x;
+        __m256 v0 = _mm256_loadu_ps(src), v1 = _mm256_loadu_ps(src + 8), v2 = _mm256_loadu_ps(src + 16);
+        // Regroup so each 128-bit lane holds the a/b/c words of 4 points
+        __m256 a = _mm256_permute2f128_ps(v0, v1, 0x30);
+        __m256 b = _mm256_permute2f128_ps(v0, v2, 0x21);
+        __m256 cc = _mm256_permute2f128_ps(v1, v2, 0x30);
+        __m256 x, y, z;
+        VECMATH_AOS_TO_SOA(_mm256_shuffle_ps, a, b, cc, x, y, z)
+        __m256 rx = _mm256_fmadd_ps(w[0][0], x, _mm256_fmadd_ps(w[1][0], y, _mm256_fmadd_ps(w[2][0], z, w[3][0])));
+        __m256 ry = _mm256_fmadd_ps(w[0][1], x, _mm256_fmadd_ps(w[1][1], y, _mm256_fmadd_ps(w[2][1], z, w[3][1])));
+        __m256 rz = _mm256_fmadd_ps(w[0][2], x, _mm256_fmadd_ps(w[1][2], y, _mm256_fmadd_ps(w[2][2], z, w[3][2])));
+        VECMATH_SOA_TO_AOS(_mm256_shuffle_ps, rx, ry, rz, a, b, cc)
+        float* dst = &out[i].x;
+        _mm256_storeu_ps(dst, _mm256_permute2f128_ps(a, b, 0x20));
+        _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(cc, a, 0x30));
+        _mm256_storeu_ps(dst + 16, _mm256_permute2f128_ps(b, cc, 0x31));
+    }
+#endif
+#if defined(VECMATH_SIMD)
+    __m128 k[4][3];
+    for (int col = 0; col < 4; ++col)
+        for (int row = 0; row < 3; ++row)
+            k[col][row] = _mm_set1_ps(c[col][row]);
+    for (size_t blocks = count & ~(size_t)3; i < blocks; i += 4) {
+        const float* src = &in[i].x;
+        __m128 a = _mm_loadu_ps(src), b = _mm_loadu_ps(src + 4), cc = _mm_loadu_ps(src + 8);
+        __m128 x, y, z;
+        VECMATH_AOS_TO_SOA(_mm_shuffle_ps, a, b, cc, x, y, z)
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(k[0][0], x), _mm_mul_ps(k[1][0], y)), _mm_add_ps(_mm_mul_ps(k[2][0], z), k[3][0]));
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(k[0][1], x), _mm_mul_ps(k[1][1], y)), _mm_add_ps(_mm_mul_ps(k[2][1], z), k[3][1]));
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(k[0][2], x), _mm_mul_ps(k[1][2], y)), _mm_add_ps(_mm_mul_ps(k[2][2], z), k[3][2]));
+        VECMATH_SOA_TO_AOS(_mm_shuffle_ps, rx, ry, rz, a, b, cc)
+        float* dst = &out[i].x;
+        _mm_storeu_ps(dst, a);
+        _mm_storeu_ps(dst + 4, b);
+        _mm_storeu_ps(dst + 8, cc);
+    }
+#endif
+    for (; i < count; ++i) {
+        Vec3 v = in[i];
+        out[i] = Vec3(
+            c[0][0] * v.x + c[1][0] * v.y + c[2][0] * v.z + c[3][0],
+            c[0][1] * v.x + c[1][1] * v.y + c[2][1] * v.z + c[3][1],
+            c[0][2] * v.x + c[1][2] * v.y + c[2][2] * v.z + c[3][2]
+        );
+    }
+}
+
+// out[i] = (m * vec4(in[i], 1)).xyz for affine m
+inline void transformPoints(const Mat4& m, const Vec3* in, Vec3* out, size_t count) {
+    const float c[4][3] = {
+        { m.m[0][0], m.m[0][1], m.m[0][2] },
+        { m.m[1][0], m.m[1][1], m.m[1][2] },
+        { m.m[2][0], m.m[2][1], m.m[2][2] },
+        { m.m[3][0], m.m[3][1], m.m[3][2] },
+    };
+    transformVec3Batch(c, in, out, count);
+}
+
+// out[i] = normalMatrix * in[i]; results are not renormalized
+inline void transformNormals(const Mat3& normalMatrix, const Vec3* in, Vec3* out, size_t count) {
+    const float (*n)[3] = normalMatrix.m;
+    const float c[4][3] = {
+        { n[0][0], n[0][1], n[0][2] },
+        { n[1][0], n[1][1], n[1][2] },
+        { n[2][0], n[2][1], n[2][2] },
+        { 0.0f, 0.0f, 0.0f },
+    };
+    transformVec3Batch(c, in, out, count);
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// Frustum Culling
+// ---------------------------------------------------------------------------------------------------------
+// Planes are extracted from a clip matrix (Gribb & Hartmann) and normalized, so n.p + d is the
+// signed distance of p, positive inside. With the projection * view matrix the planes are in world
+// space.
+struct Frustum {
+    Vec4 planes[6]; // Left, right, bottom, top, near, far
+
+    static Frustum fromMatrix(const Mat4& clip) {
+        Frustum f;
+        for (int i = 0; i < 6; ++i) {
+            int row = i / 2;
+            float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+            float p[4];
+            for (int col = 0; col < 4; ++col) p[col] = clip.m[col][3] + sign * clip.m[col][row];
+            float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+            f.planes[i] = Vec4(p[0] / length, p[1] / length, p[2] / length, p[3] / length);
+        }
+        return f;
+    }
+
+    bool intersectsSphere(const Vec3& center, float radius) const {
+        for (const Vec4& p : planes) {
+            if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) return false;
+        }
+        return true;
+    }
+
+    // Test the box [lo, hi] against the planes set in `mask` (bit i = plane i). Returns false if
+    // it is outside; otherwise clears the bits of planes it lies fully inside of.
+    bool classifyBox(const Vec3& lo, const Vec3& hi, unsigned int& mask) const {
+        Vec3 center = (lo + hi) * 0.5f, extent = (hi - lo) * 0.5f;
+        for (int i = 0; i < 6; ++i) {
+            if (!(mask & (1u << i))) continue;
+            const Vec4& p = planes[i];
+            float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+            float reach = std::fabs(p.x) * extent.x + std::fabs(p.y) * extent.y + std::fabs(p.z) * extent.z;
+            if (distance < -reach) return false;
+            if (distance >= reach) mask &= ~(1u << i);
+        }
+        return true;
+    }
+};
+
+// Append first + i to `visible` for every sphere i in [0, count) that intersects the frustum.
+// Spheres are given as separate x/y/z/radius arrays so the SIMD path tests 4 per iteration.
+// Returns the number of indices written.
+inline size_t cullSpheres(const Frustum& f, const float* x, const float* y, const float* z, const float* r,
+                          size_t count, unsigned int first, unsigned int* visible, bool useSIMD = true) {
+    size_t written = 0, i = 0;
+#if defined(VECMATH_SIMD)
+    if (useSIMD) {
+        for (size_t blocks = count & ~(size_t)3; i < blocks; i += 4) {
+            __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+            __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const Vec4& p : f.planes) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), px), _mm_mul_ps(_mm_set1_ps(p.y), py)),
+                                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z), pz), _mm_set1_ps(p.w)));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (int k = 0; k < 4; ++k) {
+                if (mask & (1 << k)) visible[written++] = first + (unsigned int)(i + k);
+            }
+        }
+    }
+#else
+    (void)useSIMD;
+#endif
+    for (; i < count; ++i) {
+        if (f.intersectsSphere(Vec3(x[i], y[i], z[i]), r[i])) visible[written++] = first + (unsigned int)i;
+    }
+    return written;
+}
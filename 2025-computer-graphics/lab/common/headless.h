@@ -0,0 +1,291 @@
+#pragma once
+
+// ---------------------------------------------------------------------------------------------------------
+// Headless Rendering
+// ---------------------------------------------------------------------------------------------------------
+// --headless runs without a window or display server. The GL context comes from EGL on Mesa's
+// surfaceless platform and draws into an offscreen FBO, whose frames are read back and optionally
+// written as binary PPMs. Frame count, resolution and a camera script come from the command line.
+// Time advances by exactly 1/fps per frame, so runs are reproducible.
+//
+// The EGL part is compiled when CMake finds EGL (CG_HEADLESS_EGL); otherwise HeadlessContext::create
+// reports that it is unavailable. Include after the GL headers (GLFW/glfw3.h).
+// Shared by all labs; each CMakeLists adds lab/common to the include path. Lab 2 rasterizes on the
+// CPU, so it only uses the option parsing, the camera script and the timing summary.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef CG_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+struct HeadlessOptions {
+    bool enabled = false;
+    int frames = 60;
+    int width = 1280;
+    int height = 720;
+    float fps = 60.0f;
+    std::string cameraScript; // Empty: the lab's default camera
+    std::string outputPrefix; // Frame i goes to <prefix><i, 4 digits>.ppm; empty writes nothing
+};
+
+const char* const HEADLESS_USAGE = "[--headless] [--frames N] [--size WxH] [--fps F] [--camera script.txt] [--output prefix]";
+
+// Consume the headless option at argv[i] (and its value); false if argv[i] is not one
+inline bool parseHeadlessOption(int argc, char** argv, int& i, HeadlessOptions& options) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--headless") {
+        options.enabled = true;
+    } else if (arg == "--frames" && hasValue) {
+        options.frames = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--size" && hasValue) {
+        int width = 0, height = 0;
+        if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) return false;
+        options.width = width;
+        options.height = height;
+    } else if (arg == "--fps" && hasValue) {
+        options.fps = std::max(1.0f, (float)std::atof(argv[++i]));
+    } else if (arg == "--camera" && hasValue) {
+        options.cameraScript = argv[++i];
+    } else if (arg == "--output" && hasValue) {
+        options.outputPrefix = argv[++i];
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Keyframed parameters, one keyframe per line: "<frame> <name> <value> [<name> <value> ...]", '#'
+// starts a comment. Each named track is interpolated linearly between its keyframes and held
+// before the first and after the last; names a lab does not use are ignored.
+struct CameraScript {
+    std::map<std::string, std::vector<std::pair<float, float>>> tracks;
+
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) return false;
+        std::string line;
+        while (std::getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            float frame;
+            if (!(fields >> frame)) continue;
+            std::string name;
+            float value;
+            while (fields >> name >> value) tracks[name].push_back(std::make_pair(frame, value));
+        }
+        for (auto& track : tracks) std::stable_sort(track.second.begin(), track.second.end());
+        return true;
+    }
+
+    float value(const std::string& name, float frame, float fallback) const {
+        auto it = tracks.find(name);
+        if (it == tracks.end()) return fallback;
+        const std::vector<std::pair<float, float>>& keys = it->second;
+        if (frame <= keys.front().first) return keys.front().second;
+        for (size_t k = 1; k < keys.size(); ++k) {
+            if (frame > keys[k].first) continue;
+            float t = (frame - keys[k - 1].first) / std::max(keys[k].first - keys[k - 1].first, 1e-6f);
+            return keys[k - 1].second + (keys[k].second - keys[k - 1].second) * t;
+        }
+        return keys.back().second;
+    }
+};
+
+// Bottom-up RGBA rows, as glReadPixels returns them, to a top-down binary PPM
+inline bool writeHeadlessPPM(const std::string& path, const std::vector<unsigned char>& rgba, int width, int height) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<unsigned char> row((size_t)width * 3);
+    for (int y = height - 1; y >= 0; --y) {
+        const unsigned char* in = &rgba[(size_t)y * width * 4];
+        for (int x = 0; x < width; ++x) std::memcpy(&row[(size_t)x * 3], in + x * 4, 3);
+        out.write((const char*)row.data(), row.size());
+    }
+    return (bool)out;
+}
+
+// Frame time summary over per-frame milliseconds
+inline void printHeadlessTimings(const std::vector<double>& frameMs) {
+    if (frameMs.empty()) return;
+    std::vector<double> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double ms : sorted) total += ms;
+    double mean = total / sorted.size();
+    std::printf("Headless: %d frames, mean %.3f ms, median %.3f ms, min %.3f ms, max %.3f ms (%.1f frames/s)\n",
+                (int)sorted.size(), mean, sorted[sorted.size() / 2], sorted.front(), sorted.back(), 1000.0 / mean);
+}
+
+#ifndef GLAPIENTRY
+#define GLAPIENTRY
+#endif
+
+typedef void (*HeadlessProc)(void); // Same shape as GLFWglproc, so either loader fits one signature
+
+// Surfaceless EGL context with an RGBA8 + depth24/stencil8 framebuffer object as its render target
+struct HeadlessContext {
+    int width = 0;
+    int height = 0;
+    GLuint framebuffer = 0;
+    GLuint renderbuffers[2] = {}; // Colour, depth-stencil
+    std::vector<unsigned char> pixels;
+    std::vector<double> frameMs;  // Submission start to glFinish, per frame
+    std::chrono::steady_clock::time_point frameStart;
+
+#ifdef CG_HEADLESS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    void (GLAPIENTRY *genFramebuffers)(GLsizei, GLuint*) = NULL;
+    void (GLAPIENTRY *deleteFramebuffers)(GLsizei, const GLuint*) = NULL;
+    void (GLAPIENTRY *bindFramebuffer)(GLenum, GLuint) = NULL;
+    void (GLAPIENTRY *genRenderbuffers)(GLsizei, GLuint*) = NULL;
+    void (GLAPIENTRY *deleteRenderbuffers)(GLsizei, const GLuint*) = NULL;
+    void (GLAPIENTRY *bindRenderbuffer)(GLenum, GLuint) = NULL;
+    void (GLAPIENTRY *renderbufferStorage)(GLenum, GLenum, GLsizei, GLsizei) = NULL;
+    void (GLAPIENTRY *framebufferRenderbuffer)(GLenum, GLenum, GLenum, GLuint) = NULL;
+    GLenum (GLAPIENTRY *checkFramebufferStatus)(GLenum) = NULL;
+
+    const GLubyte* (GLAPIENTRY *getStringi)(GLenum, GLuint) = NULL;
+
+    static HeadlessProc getProcAddress(const char* name) { return (HeadlessProc)eglGetProcAddress(name); }
+
+    // Context of at least the given version; compatibility profile unless core is set
+    bool create(int w, int h, int major, int minor, bool core) {
+        width = w;
+        height = h;
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (!getPlatformDisplay) return fail("eglGetPlatformDisplayEXT is missing");
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        EGLint eglMajor = 0, eglMinor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor)) return fail("no surfaceless EGL display");
+        if (!eglBindAPI(EGL_OPENGL_API)) return fail("EGL cannot bind desktop OpenGL");
+
+        // The config only has to exist: nothing is drawn through an EGL surface, and the platform has no window configs
+        const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) return fail("no EGL config");
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, core ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT) return fail("cannot create the GL context");
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) return fail("surfaceless eglMakeCurrent failed");
+
+        genFramebuffers = (decltype(genFramebuffers))getProcAddress("glGenFramebuffers");
+        deleteFramebuffers = (decltype(deleteFramebuffers))getProcAddress("glDeleteFramebuffers");
+        bindFramebuffer = (decltype(bindFramebuffer))getProcAddress("glBindFramebuffer");
+        genRenderbuffers = (decltype(genRenderbuffers))getProcAddress("glGenRenderbuffers");
+        deleteRenderbuffers = (decltype(deleteRenderbuffers))getProcAddress("glDeleteRenderbuffers");
+        bindRenderbuffer = (decltype(bindRenderbuffer))getProcAddress("glBindRenderbuffer");
+        renderbufferStorage = (decltype(renderbufferStorage))getProcAddress("glRenderbufferStorage");
+        framebufferRenderbuffer = (decltype(framebufferRenderbuffer))getProcAddress("glFramebufferRenderbuffer");
+        checkFramebufferStatus = (decltype(checkFramebufferStatus))getProcAddress("glCheckFramebufferStatus");
+        getStringi = (decltype(getStringi))getProcAddress("glGetStringi");
+        if (!genFramebuffers || !renderbufferStorage || !checkFramebufferStatus) return fail("framebuffer objects are unavailable");
+
+        const GLenum RENDERBUFFER = 0x8D41, FRAMEBUFFER = 0x8D40, COLOR_ATTACHMENT0 = 0x8CE0;
+        const GLenum DEPTH_STENCIL_ATTACHMENT = 0x821A, DEPTH24_STENCIL8 = 0x88F0, FRAMEBUFFER_COMPLETE = 0x8CD5;
+        genFramebuffers(1, &framebuffer);
+        genRenderbuffers(2, renderbuffers);
+        bindRenderbuffer(RENDERBUFFER, renderbuffers[0]);
+        renderbufferStorage(RENDERBUFFER, GL_RGBA8, width, height);
+        bindRenderbuffer(RENDERBUFFER, renderbuffers[1]);
+        renderbufferStorage(RENDERBUFFER, DEPTH24_STENCIL8, width, height);
+        bindRenderbuffer(RENDERBUFFER, 0);
+        bindFramebuffer(FRAMEBUFFER, framebuffer);
+        framebufferRenderbuffer(FRAMEBUFFER, COLOR_ATTACHMENT0, RENDERBUFFER, renderbuffers[0]);
+        framebufferRenderbuffer(FRAMEBUFFER, DEPTH_STENCIL_ATTACHMENT, RENDERBUFFER, renderbuffers[1]);
+        if (checkFramebufferStatus(FRAMEBUFFER) != FRAMEBUFFER_COMPLETE) return fail("offscreen framebuffer incomplete");
+        // A surfaceless context has no default framebuffer, so draws and reads go to the FBO
+        glDrawBuffer(COLOR_ATTACHMENT0);
+        glReadBuffer(COLOR_ATTACHMENT0);
+        glViewport(0, 0, width, height);
+
+        std::cout << "Headless: " << width << "x" << height << " on " << glGetString(GL_RENDERER)
+                  << " (EGL " << eglMajor << "." << eglMinor << ", GL " << glGetString(GL_VERSION) << ")" << std::endl;
+        return true;
+    }
+
+    // glfwExtensionSupported needs a GLFW context, so headless runs ask the driver directly
+    bool extensionSupported(const char* name) const {
+        GLint count = 0;
+        glGetIntegerv(0x821D, &count); // GL_NUM_EXTENSIONS
+        for (GLint i = 0; getStringi && i < count; ++i) {
+            if (std::strcmp((const char*)getStringi(GL_EXTENSIONS, i), name) == 0) return true;
+        }
+        return false;
+    }
+
+    void destroy() {
+        if (context != EGL_NO_CONTEXT) {
+            if (framebuffer) {
+                deleteFramebuffers(1, &framebuffer);
+                deleteRenderbuffers(2, renderbuffers);
+            }
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(display, context);
+        }
+        if (display != EGL_NO_DISPLAY) eglTerminate(display);
+        context = EGL_NO_CONTEXT;
+        display = EGL_NO_DISPLAY;
+    }
+#else
+    static HeadlessProc getProcAddress(const char*) { return NULL; }
+
+    bool create(int, int, int, int, bool) { return fail("this build has no EGL support"); }
+
+    bool extensionSupported(const char*) const { return false; }
+
+    void destroy() {}
+#endif
+
+    // Rebind the offscreen target (code that binds its own FBOs must bind `framebuffer` back)
+    void beginFrame() {
+#ifdef CG_HEADLESS_EGL
+        bindFramebuffer(0x8D40, framebuffer);
+#endif
+        frameStart = std::chrono::steady_clock::now();
+    }
+
+    // Wait for the frame, record its time and write it when a prefix is set
+    void endFrame(int frame, const std::string& outputPrefix) {
+        glFinish();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        if (outputPrefix.empty()) return;
+        pixels.resize((size_t)width * height * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), "%04d.ppm", frame);
+        if (!writeHeadlessPPM(outputPrefix + suffix, pixels, width, height)) {
+            std::cout << "ERROR::HEADLESS: cannot write " << outputPrefix + suffix << std::endl;
+        }
+    }
+
+    // Frame time summary; readback and file writes are not included
+    void printTimings() const { printHeadlessTimings(frameMs); }
+
+private:
+    bool fail(const char* reason) {
+        std::cout << "ERROR::HEADLESS: " << reason << std::endl;
+        return false;
+    }
+};